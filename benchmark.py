@@ -0,0 +1,136 @@
+"""End-to-end throughput benchmark on a synthetic corpus.
+
+Generates a Zipf distributed corpus with `bench corpus`, then times sent2vec
+training, print-sentence-vectors, quantize and nnSent on it and prints the
+wall time, throughput and peak RSS of every run as JSON.
+
+Embedding and nnSent throughputs exclude model loading: each of them is also
+run on an empty input and that startup time is subtracted.
+
+    make opt bench
+    python3 benchmark.py --binary ./fasttext --threads 1,2,4
+"""
+import argparse
+import itertools
+import json
+import os
+import subprocess
+import sys
+import time
+
+
+def run(cmd, stdin_path=None):
+    """Runs cmd and returns (wall seconds, peak RSS in MB) of that process."""
+    stdin = open(stdin_path, 'rb') if stdin_path else subprocess.DEVNULL
+    try:
+        start = time.perf_counter()
+        proc = subprocess.Popen(cmd, stdin=stdin, stdout=subprocess.DEVNULL,
+                                stderr=subprocess.DEVNULL)
+        _, status, usage = os.wait4(proc.pid, 0)
+        wall = time.perf_counter() - start
+    finally:
+        if stdin_path:
+            stdin.close()
+    if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+        sys.exit("command failed: %s" % ' '.join(cmd))
+    # ru_maxrss is in kilobytes on Linux
+    return wall, usage.ru_maxrss / 1024.0
+
+
+def head(src, dest, n):
+    """Copies the first n lines of src to dest and returns how many it got."""
+    with open(src, 'rb') as in_fs, open(dest, 'wb') as out_fs:
+        lines = list(itertools.islice(in_fs, n))
+        out_fs.writelines(lines)
+    return len(lines)
+
+
+def result(task, threads, wall, rss, count, unit):
+    return {'task': task, 'threads': threads, 'wall_s': round(wall, 3),
+            'throughput': round(count / wall, 1) if count and wall > 0 else None,
+            'unit': unit, 'peak_rss_mb': round(rss, 1)}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--binary', default='./sent2vec',
+                        help='sent2vec executable')
+    parser.add_argument('--bench', default='./bench',
+                        help='bench executable (for the corpus generator)')
+    parser.add_argument('--workdir', default='benchmark_data')
+    parser.add_argument('--sentences', type=int, default=1000000)
+    parser.add_argument('--vocab', type=int, default=100000)
+    parser.add_argument('--length', type=int, default=20)
+    parser.add_argument('--zipf', type=float, default=1.0)
+    parser.add_argument('--threads', default='1,2,4',
+                        help='comma separated thread counts')
+    parser.add_argument('--dim', type=int, default=100)
+    parser.add_argument('--epoch', type=int, default=1)
+    parser.add_argument('--embed-lines', type=int, default=100000)
+    parser.add_argument('--nn-corpus', type=int, default=10000,
+                        help='sentences indexed by nnSent')
+    parser.add_argument('--nn-queries', type=int, default=1000)
+    args = parser.parse_args()
+
+    threads = [int(t) for t in args.threads.split(',')]
+    os.makedirs(args.workdir, exist_ok=True)
+    corpus = os.path.join(args.workdir, 'corpus.txt')
+    empty = os.path.join(args.workdir, 'empty.txt')
+    embed = os.path.join(args.workdir, 'embed.txt')
+    nn_corpus = os.path.join(args.workdir, 'nn_corpus.txt')
+    nn_queries = os.path.join(args.workdir, 'nn_queries.txt')
+
+    start = time.perf_counter()
+    with open(corpus, 'wb') as out_fs:
+        subprocess.check_call([args.bench, 'corpus',
+                               '-sentences', str(args.sentences),
+                               '-vocab', str(args.vocab),
+                               '-length', str(args.length),
+                               '-zipf', str(args.zipf)], stdout=out_fs)
+    corpus_s = time.perf_counter() - start
+    open(empty, 'wb').close()
+    embed_lines = head(corpus, embed, args.embed_lines)
+    head(corpus, nn_corpus, args.nn_corpus)
+    nn_queries_lines = head(corpus, nn_queries, args.nn_queries)
+    # the corpus starts with the vocabulary, one line per `length` words
+    tokens = args.sentences * args.length + args.vocab
+
+    results = []
+    for t in threads:
+        output = os.path.join(args.workdir, 'model_%d' % t)
+        wall, rss = run([args.binary, 'sent2vec', '-input', corpus,
+                         '-output', output, '-dim', str(args.dim),
+                         '-epoch', str(args.epoch), '-minCount', '1',
+                         '-thread', str(t), '-verbose', '0'])
+        results.append(result('train', t, wall, rss,
+                              tokens * args.epoch, 'tokens/s'))
+
+        model = output + '.bin'
+        cmd = [args.binary, 'print-sentence-vectors', model, '-thread', str(t)]
+        startup, _ = run(cmd, empty)
+        wall, rss = run(cmd, embed)
+        results.append(result('print-sentence-vectors', t, wall - startup, rss,
+                              embed_lines, 'sentences/s'))
+
+    model = os.path.join(args.workdir, 'model_%d' % threads[-1])
+    wall, rss = run([args.binary, 'quantize', '-input', corpus,
+                     '-output', model, '-verbose', '0'])
+    results.append(result('quantize', 1, wall, rss, None, None))
+
+    cmd = [args.binary, 'nnSent', model + '.bin', nn_corpus, '10']
+    startup, _ = run(cmd, empty)
+    wall, rss = run(cmd, nn_queries)
+    results.append(result('nnSent', 1, wall - startup, rss,
+                          nn_queries_lines, 'queries/s'))
+
+    json.dump({'corpus': {'sentences': args.sentences, 'vocab': args.vocab,
+                          'length': args.length, 'zipf': args.zipf,
+                          'tokens': tokens,
+                          'generation_s': round(corpus_s, 3)},
+               'dim': args.dim, 'epoch': args.epoch,
+               'results': results}, sys.stdout, indent=2)
+    sys.stdout.write('\n')
+
+
+if __name__ == '__main__':
+    main()
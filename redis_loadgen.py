@@ -0,0 +1,395 @@
+"""Load generator for redis-mode.
+
+Pushes tokenized-text requests into the input queue of a running
+`sent2vec redis-mode` at a fixed rate (or with a fixed number of requests in
+flight), collects the responses from the result queues and prints the
+sustained throughput and end-to-end latency percentiles as JSON.
+
+The queue can be a real Redis or, with --fake-redis, a minimal Redis server
+started inside this process (PING, AUTH, RPUSH, BLPOP, EXPIRE, DEL), so that
+no redis-server or client library has to be installed. With --server the
+redis-mode process is started as well, pointed at that queue:
+
+    python3 redis_loadgen.py --fake-redis --input tweets.tok --rate 500 \\
+        --server "./sent2vec redis-mode model.bin"
+"""
+import argparse
+import collections
+import json
+import math
+import os
+import random
+import shlex
+import socket
+import socketserver
+import subprocess
+import sys
+import threading
+import time
+
+
+class RespError(Exception):
+    pass
+
+
+class RespClient(object):
+    """Blocking client for the few Redis commands used here."""
+
+    def __init__(self, host, port, password=None):
+        self.sock = socket.create_connection((host, port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.reader = self.sock.makefile('rb')
+        if password:
+            self.command('AUTH', password)
+
+    def command(self, *args):
+        self.sock.sendall(encode_command(args))
+        return read_reply(self.reader)
+
+    def close(self):
+        self.reader.close()
+        self.sock.close()
+
+
+def encode_command(args):
+    out = [b'*%d\r\n' % len(args)]
+    for arg in args:
+        if not isinstance(arg, bytes):
+            arg = str(arg).encode('utf-8')
+        out.append(b'$%d\r\n%s\r\n' % (len(arg), arg))
+    return b''.join(out)
+
+
+def read_reply(reader):
+    line = reader.readline()
+    if not line:
+        raise ConnectionError('connection closed')
+    kind, rest = line[:1], line[1:-2]
+    if kind == b'+':
+        return rest.decode('utf-8')
+    if kind == b'-':
+        raise RespError(rest.decode('utf-8'))
+    if kind == b':':
+        return int(rest)
+    if kind == b'$':
+        size = int(rest)
+        if size < 0:
+            return None
+        data = reader.read(size + 2)
+        return data[:-2]
+    if kind == b'*':
+        size = int(rest)
+        if size < 0:
+            return None
+        return [read_reply(reader) for _ in range(size)]
+    raise RespError('unexpected reply %r' % line)
+
+
+class FakeRedis(object):
+    """In-process stand-in for redis-server, good enough for redis-mode."""
+
+    def __init__(self, port=0):
+        self.lists = collections.defaultdict(collections.deque)
+        self.expiry = {}
+        self.cond = threading.Condition()
+        fake = self
+
+        class Handler(socketserver.StreamRequestHandler):
+            def handle(self):
+                self.connection.setsockopt(socket.IPPROTO_TCP,
+                                           socket.TCP_NODELAY, 1)
+                while True:
+                    try:
+                        args = read_reply(self.rfile)
+                    except (ConnectionError, OSError):
+                        return
+                    if not isinstance(args, list) or not args:
+                        return
+                    self.wfile.write(fake.execute(args))
+                    self.wfile.flush()
+
+        class Server(socketserver.ThreadingMixIn, socketserver.TCPServer):
+            daemon_threads = True
+            allow_reuse_address = True
+
+        self.server = Server(('127.0.0.1', port), Handler)
+        self.port = self.server.server_address[1]
+        thread = threading.Thread(target=self.server.serve_forever)
+        thread.daemon = True
+        thread.start()
+
+    def _expire(self, key):
+        deadline = self.expiry.get(key)
+        if deadline is not None and deadline <= time.time():
+            self.lists.pop(key, None)
+            del self.expiry[key]
+
+    def execute(self, args):
+        name = args[0].upper()
+        if name in (b'PING', b'AUTH', b'SELECT'):
+            return b'+PONG\r\n' if name == b'PING' else b'+OK\r\n'
+        with self.cond:
+            if name in (b'RPUSH', b'LPUSH'):
+                key = args[1]
+                self._expire(key)
+                if name == b'RPUSH':
+                    self.lists[key].extend(args[2:])
+                else:
+                    self.lists[key].extendleft(args[2:])
+                self.cond.notify_all()
+                return b':%d\r\n' % len(self.lists[key])
+            if name == b'BLPOP':
+                keys, timeout = args[1:-1], float(args[-1])
+                deadline = time.time() + timeout if timeout > 0 else None
+                while True:
+                    for key in keys:
+                        self._expire(key)
+                        if self.lists.get(key):
+                            value = self.lists[key].popleft()
+                            return encode_array([key, value])
+                    remaining = None
+                    if deadline is not None:
+                        remaining = deadline - time.time()
+                        if remaining <= 0:
+                            return b'*-1\r\n'
+                    self.cond.wait(remaining)
+            if name == b'EXPIRE':
+                self.expiry[args[1]] = time.time() + float(args[2])
+                return b':1\r\n'
+            if name == b'DEL':
+                removed = sum(1 for key in args[1:]
+                              if self.lists.pop(key, None) is not None)
+                return b':%d\r\n' % removed
+        return b'-ERR unknown command\r\n'
+
+    def close(self):
+        self.server.shutdown()
+
+
+def encode_array(items):
+    out = [b'*%d\r\n' % len(items)]
+    for item in items:
+        out.append(b'$%d\r\n%s\r\n' % (len(item), item))
+    return b''.join(out)
+
+
+def load_texts(path, count, rng):
+    if path:
+        with open(path, encoding='utf-8') as in_fs:
+            texts = [line.strip() for line in in_fs if line.strip()]
+        if not texts:
+            sys.exit('no text in %s' % path)
+        return texts
+    # tweet-like lengths over a Zipf vocabulary, as in `bench corpus`
+    weights = [1.0 / (i + 1) for i in range(10000)]
+    words = ['w%d' % i for i in range(10000)]
+    return [' '.join(rng.choices(words, weights, k=rng.randint(5, 40)))
+            for _ in range(count)]
+
+
+def percentile(values, p):
+    if not values:
+        return None
+    index = max(0, int(math.ceil(p * len(values))) - 1)
+    return values[index]
+
+
+class LoadGenerator(object):
+
+    def __init__(self, args):
+        self.args = args
+        self.prefix = 'loadgen:%d:%d' % (os.getpid(), int(time.time()))
+        self.sent = {}
+        self.latencies = []
+        self.timed_out = 0
+        self.lock = threading.Lock()
+        self.done = threading.Event()
+        self.inflight = threading.Semaphore(max(args.concurrency, 1))
+
+    def connect(self):
+        return RespClient(self.args.host, self.args.port, self.args.password)
+
+    def request(self, index, text):
+        payload = {'text_tokenized': text,
+                   'result_queue': '%s:results:%d' % (
+                       self.prefix, index % self.args.collectors),
+                   'loadgen_id': index}
+        if self.args.encoding:
+            payload['encoding'] = self.args.encoding
+        return json.dumps(payload)
+
+    def collect(self, queue):
+        client = self.connect()
+        while not self.done.is_set():
+            reply = client.command('BLPOP', queue, 1)
+            if reply is None:
+                continue
+            received = time.perf_counter()
+            try:
+                index = json.loads(reply[1].decode('utf-8'))['loadgen_id']
+            except (ValueError, KeyError):
+                continue
+            with self.lock:
+                sent = self.sent.pop(index, None)
+                if sent is not None:
+                    self.latencies.append(received - sent)
+            if sent is not None and self.args.rate <= 0:
+                self.inflight.release()
+        client.close()
+
+    def expire(self):
+        """Gives up on requests that have waited longer than --timeout.
+
+        In closed-loop mode their slots are freed, so that lost responses
+        cannot stall the run."""
+        deadline = time.perf_counter() - self.args.timeout
+        with self.lock:
+            expired = [i for i, sent in self.sent.items() if sent < deadline]
+            for i in expired:
+                del self.sent[i]
+            self.timed_out += len(expired)
+        if self.args.rate <= 0:
+            for _ in expired:
+                self.inflight.release()
+
+    def warmup(self, client, text):
+        """Waits until the server answers, i.e. it has loaded its model."""
+        queue = '%s:warmup' % self.prefix
+        payload = json.dumps({'text_tokenized': text, 'result_queue': queue})
+        client.command('RPUSH', self.args.queue, payload)
+        reply = client.command('BLPOP', queue, self.args.startup_timeout)
+        if reply is None:
+            sys.exit('no response from redis-mode within %ds'
+                     % self.args.startup_timeout)
+
+    def run(self, texts):
+        args = self.args
+        client = self.connect()
+        self.warmup(client, texts[0])
+        collectors = [threading.Thread(target=self.collect,
+                                       args=('%s:results:%d' % (self.prefix, i),))
+                      for i in range(args.collectors)]
+        for thread in collectors:
+            thread.daemon = True
+            thread.start()
+
+        start = time.perf_counter()
+        index = 0
+        while index < args.requests:
+            if args.rate > 0:
+                # open loop: push every request that is due, in one RPUSH
+                now = time.perf_counter()
+                due = min(args.requests, int((now - start) * args.rate) + 1)
+                if due <= index:
+                    time.sleep(min(0.001, (index - (now - start) * args.rate)
+                                   / args.rate))
+                    continue
+                batch = range(index, due)
+            else:
+                while not self.inflight.acquire(timeout=0.1):
+                    self.expire()
+                batch = range(index, index + 1)
+            payloads = [self.request(i, texts[i % len(texts)]) for i in batch]
+            with self.lock:
+                now = time.perf_counter()
+                for i in batch:
+                    self.sent[i] = now
+            client.command('RPUSH', args.queue, *payloads)
+            index = batch[-1] + 1
+        last_sent = time.perf_counter()
+
+        deadline = last_sent + args.timeout
+        while time.perf_counter() < deadline:
+            with self.lock:
+                if not self.sent:
+                    break
+            time.sleep(0.01)
+        end = time.perf_counter()
+        self.done.set()
+        with self.lock:
+            self.timed_out += len(self.sent)
+        for thread in collectors:
+            thread.join()
+        client.close()
+
+        latencies = sorted(self.latencies)
+        received = len(latencies)
+        ms = lambda value: round(value * 1e3, 3) if value is not None else None
+        return {
+            'requests': args.requests,
+            'received': received,
+            'lost': args.requests - received,
+            'timed_out': self.timed_out,
+            'target_rate': args.rate if args.rate > 0 else None,
+            'concurrency': args.concurrency if args.rate <= 0 else None,
+            'send_s': round(last_sent - start, 3),
+            'duration_s': round(end - start, 3),
+            'throughput_rps': round(received / (end - start), 1),
+            'latency_ms': {
+                'mean': ms(sum(latencies) / received) if received else None,
+                'p50': ms(percentile(latencies, 0.50)),
+                'p90': ms(percentile(latencies, 0.90)),
+                'p99': ms(percentile(latencies, 0.99)),
+                'p999': ms(percentile(latencies, 0.999)),
+                'max': ms(latencies[-1] if latencies else None),
+            },
+        }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--host', default=os.environ.get('REDIS_HOST', '127.0.0.1'))
+    parser.add_argument('--port', type=int,
+                        default=int(os.environ.get('REDIS_PORT', 6379)))
+    parser.add_argument('--password', default=os.environ.get('REDIS_PASSWORD', ''))
+    parser.add_argument('--fake-redis', action='store_true',
+                        help='serve the queues from this process')
+    parser.add_argument('--server',
+                        help='redis-mode command to start, without the queue '
+                             'name (e.g. "./sent2vec redis-mode model.bin")')
+    parser.add_argument('--queue', default='sent2vec_loadgen',
+                        help='input queue of redis-mode')
+    parser.add_argument('--input', help='tokenized sentences, one per line '
+                                        '(synthetic text if omitted)')
+    parser.add_argument('--requests', type=int, default=10000)
+    parser.add_argument('--rate', type=float, default=0,
+                        help='requests per second; 0 keeps --concurrency '
+                             'requests in flight instead')
+    parser.add_argument('--concurrency', type=int, default=32)
+    parser.add_argument('--collectors', type=int, default=4,
+                        help='result queues, each drained by its own thread')
+    parser.add_argument('--encoding', choices=['f32', 'f16'],
+                        help='ask for binary vectors in the responses')
+    parser.add_argument('--timeout', type=float, default=30,
+                        help='seconds to wait for a response; in closed loop '
+                             'a request is counted as timed out after that')
+    parser.add_argument('--startup-timeout', type=int, default=300)
+    parser.add_argument('--seed', type=int, default=0)
+    args = parser.parse_args()
+
+    fake = None
+    if args.fake_redis:
+        fake = FakeRedis()
+        args.host, args.port, args.password = '127.0.0.1', fake.port, ''
+    server = None
+    if args.server:
+        env = dict(os.environ, REDIS_HOST=args.host, REDIS_PORT=str(args.port),
+                   REDIS_PASSWORD=args.password)
+        server = subprocess.Popen(shlex.split(args.server) + [args.queue],
+                                  env=env, stdout=subprocess.DEVNULL)
+    try:
+        texts = load_texts(args.input, min(args.requests, 100000),
+                           random.Random(args.seed))
+        report = LoadGenerator(args).run(texts)
+    finally:
+        if server is not None:
+            server.terminate()
+            server.wait()
+        if fake is not None:
+            fake.close()
+    json.dump(report, sys.stdout, indent=2)
+    sys.stdout.write('\n')
+
+
+if __name__ == '__main__':
+    main()
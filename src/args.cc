@@ -38,12 +38,16 @@ Args::Args() {
   verbose = 2;
   pretrainedVectors = "";
   saveOutput = 0;
+  checkpointTokens = 0;
+  checkpointMinutes = 0;
+  resume = false;
 
   qout = false;
   retrain = false;
   qnorm = false;
   cutoff = 0;
   dsub = 2;
+  storage = storage_name::pq;
 }
 
 void Args::parseArgs(int argc, char** argv) {
@@ -135,6 +139,12 @@ void Args::parseArgs(int argc, char** argv) {
       pretrainedVectors = std::string(argv[ai + 1]);
     } else if (strcmp(argv[ai], "-saveOutput") == 0) {
       saveOutput = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-checkpointTokens") == 0) {
+      checkpointTokens = atoll(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-checkpointMinutes") == 0) {
+      checkpointMinutes = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-resume") == 0) {
+      resume = true; ai--;
     } else if (strcmp(argv[ai], "-qnorm") == 0) {
       qnorm = true; ai--;
     } else if (strcmp(argv[ai], "-retrain") == 0) {
@@ -145,6 +155,20 @@ void Args::parseArgs(int argc, char** argv) {
     cutoff = atoi(argv[ai + 1]);
     } else if (strcmp(argv[ai], "-dsub") == 0) {
       dsub = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-storage") == 0) {
+      if (strcmp(argv[ai + 1], "pq") == 0) {
+        storage = storage_name::pq;
+      } else if (strcmp(argv[ai + 1], "fp16") == 0) {
+        storage = storage_name::fp16;
+      } else if (strcmp(argv[ai + 1], "bf16") == 0) {
+        storage = storage_name::bf16;
+      } else if (strcmp(argv[ai + 1], "int8") == 0) {
+        storage = storage_name::int8;
+      } else {
+        std::cout << "Unknown storage: " << argv[ai + 1] << std::endl;
+        printHelp();
+        exit(EXIT_FAILURE);
+      }
     } else {
       std::cout << "Unknown argument: " << argv[ai] << std::endl;
       printHelp();
@@ -157,6 +181,16 @@ void Args::parseArgs(int argc, char** argv) {
     printHelp();
     exit(EXIT_FAILURE);
   }
+  if (qout && storage != storage_name::pq) {
+    std::cout << "-qout only applies to -storage pq." << std::endl;
+    printHelp();
+    exit(EXIT_FAILURE);
+  }
+  if (thread < 1) {
+    std::cout << "Number of threads must be at least 1." << std::endl;
+    printHelp();
+    exit(EXIT_FAILURE);
+  }
   if (wordNgrams <= 1 && maxn == 0) {
     bucket = 0;
   }
@@ -192,12 +226,16 @@ void Args::printHelp() {
     << "  -verbose            verbosity level [" << verbose << "]\n"
     << "  -pretrainedVectors  pretrained word vectors for supervised learning []\n"
     << "  -saveOutput         whether output params should be saved [" << saveOutput << "]\n"
+    << "  -checkpointTokens   write <output>.ckpt every that many tokens [" << checkpointTokens << "]\n"
+    << "  -checkpointMinutes  write <output>.ckpt every that many minutes [" << checkpointMinutes << "]\n"
+    << "  -resume             continue training from <output>.ckpt if it exists [" << resume << "]\n"
     << "\nThe following arguments for quantization are optional:\n"
     << "  -cutoff             number of words and ngrams to retain [" << cutoff << "]\n"
     << "  -retrain            finetune embeddings if a cutoff is applied [" << retrain << "]\n"
     << "  -qnorm              quantizing the norm separately [" << qnorm << "]\n"
     << "  -qout               quantizing the classifier [" << qout << "]\n"
     << "  -dsub               size of each sub-vector [" << dsub << "]\n"
+    << "  -storage            input matrix storage {pq, fp16, bf16, int8} [pq]\n"
     << std::endl;
 }
 
@@ -10,6 +10,7 @@
 #ifndef FASTTEXT_ARGS_H
 #define FASTTEXT_ARGS_H
 
+#include <cstdint>
 #include <istream>
 #include <ostream>
 #include <string>
@@ -18,6 +19,7 @@ namespace fasttext {
 
 enum class model_name : int {cbow=1, sg, sup, sent2vec};
 enum class loss_name : int {hs=1, ns, softmax};
+enum class storage_name : uint8_t {fp32=0, pq, fp16, bf16, int8};
 
 class Args {
   public:
@@ -46,12 +48,16 @@ class Args {
     int verbose;
     std::string pretrainedVectors;
     int saveOutput;
+    int64_t checkpointTokens;
+    int checkpointMinutes;
+    bool resume;
 
     bool qout;
     bool retrain;
     bool qnorm;
     size_t cutoff;
     size_t dsub;
+    storage_name storage;
 
     void parseArgs(int, char**);
     void printHelp();
@@ -0,0 +1,337 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "args.h"
+#include "dictionary.h"
+#include "matrix.h"
+#include "model.h"
+#include "productquantizer.h"
+#include "real.h"
+#include "vector.h"
+
+using namespace fasttext;
+
+namespace {
+
+// every kernel result is folded in here so that nothing gets optimized away
+volatile real sink = 0.0;
+
+const int32_t NSAMPLES = 4096;
+const int32_t SENTENCE_LENGTH = 20;
+const int32_t NSENTENCES = 20000;
+
+struct Options {
+  std::vector<int32_t> dims;
+  std::vector<int32_t> vocabs;
+  int32_t bucket;
+  double minTime;
+  std::string filter;
+};
+
+struct Result {
+  std::string name;
+  int32_t dim;
+  int32_t vocab;
+  int64_t iterations;
+  double nsPerOp;
+};
+
+void printUsage() {
+  std::cerr
+    << "usage: bench [options]\n\n"
+    << "  -dim      comma separated vector dimensions [100,300,700]\n"
+    << "  -vocab    comma separated vocabulary sizes [10000,100000]\n"
+    << "  -bucket   number of ngram buckets of the model [100000]\n"
+    << "  -minTime  minimal measured time per benchmark in seconds [0.2]\n"
+    << "  -filter   only run benchmarks whose name contains this string []\n"
+    << "\nResults are written to stdout as JSON.\n"
+    << std::endl;
+}
+
+void printCorpusUsage() {
+  std::cerr
+    << "usage: bench corpus [options]\n\n"
+    << "  -sentences  number of sentences [1000000]\n"
+    << "  -vocab      vocabulary size [100000]\n"
+    << "  -length     words per sentence [20]\n"
+    << "  -zipf       exponent of the Zipf distribution of the words [1.0]\n"
+    << "  -seed       random seed [0]\n"
+    << "\nThe corpus is written to stdout, one sentence per line.\n"
+    << std::endl;
+}
+
+std::vector<int32_t> parseList(const char* arg) {
+  std::vector<int32_t> values;
+  std::istringstream iss(arg);
+  std::string value;
+  while (std::getline(iss, value, ',')) {
+    values.push_back(atoi(value.c_str()));
+  }
+  return values;
+}
+
+bool selected(const Options& options, const std::string& name) {
+  return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+template <typename F>
+Result measure(const std::string& name, int32_t dim, int32_t vocab,
+               double minTime, F kernel) {
+  typedef std::chrono::steady_clock clock;
+  int64_t n = 1;
+  while (true) {
+    auto begin = clock::now();
+    for (int64_t i = 0; i < n; i++) {
+      kernel(i);
+    }
+    double elapsed =
+      std::chrono::duration<double>(clock::now() - begin).count();
+    if (elapsed >= minTime) {
+      Result result = {name, dim, vocab, n, elapsed * 1e9 / n};
+      return result;
+    }
+    // grow geometrically, aiming a bit past minTime for the next round
+    int64_t next = elapsed > 0 ? int64_t(n * 1.2 * minTime / elapsed) : 0;
+    n = std::max(n * 2, next);
+  }
+}
+
+// Zipf distributed sentences over the words w0 ... w<vocab-1>, each of them
+// listed once first so that a dictionary with minCount 1 keeps them all
+void writeCorpus(std::ostream& out, int32_t vocab, int64_t sentences,
+                 int32_t length, double exponent, std::minstd_rand& rng) {
+  std::vector<double> weights(vocab);
+  for (int32_t i = 0; i < vocab; i++) {
+    weights[i] = 1.0 / std::pow(i + 1, exponent);
+  }
+  std::discrete_distribution<int32_t> zipf(weights.begin(), weights.end());
+  for (int32_t i = 0; i < vocab; i++) {
+    out << 'w' << i << ((i + 1) % length == 0 || i + 1 == vocab ? '\n' : ' ');
+  }
+  for (int64_t i = 0; i < sentences; i++) {
+    for (int32_t j = 0; j < length; j++) {
+      out << 'w' << zipf(rng) << (j + 1 < length ? ' ' : '\n');
+    }
+  }
+}
+
+void runVocab(const Options& options, int32_t vocab,
+              std::vector<Result>& results) {
+  std::minstd_rand rng(vocab);
+  std::shared_ptr<Args> args = std::make_shared<Args>();
+  args->model = model_name::sent2vec;
+  args->loss = loss_name::ns;
+  args->neg = 10;
+  args->minCount = 1;
+  args->minn = 0;
+  args->maxn = 0;
+  args->wordNgrams = 2;
+  args->dropoutK = 2;
+  args->bucket = options.bucket;
+  args->verbose = 0;
+
+  std::ostringstream oss;
+  writeCorpus(oss, vocab, NSENTENCES, SENTENCE_LENGTH, 1.0, rng);
+  const std::string corpus = oss.str();
+  std::shared_ptr<Dictionary> dict = std::make_shared<Dictionary>(args);
+  std::istringstream corpusStream(corpus);
+  dict->readFromFile(corpusStream);
+
+  std::uniform_int_distribution<int32_t> uniformWord(0, dict->nwords() - 1);
+  std::vector<int32_t> ids(NSAMPLES);
+  std::vector<std::string> words(NSAMPLES);
+  for (int32_t i = 0; i < NSAMPLES; i++) {
+    ids[i] = uniformWord(rng);
+    words[i] = dict->getWord(ids[i]);
+  }
+  std::vector<std::vector<int32_t>> lines;
+  std::istringstream lineStream(corpus);
+  std::vector<int32_t> line, labels;
+  while (lines.size() < NSAMPLES) {
+    dict->getLine(lineStream, line, labels, rng);
+    if (line.size() > 1) {
+      lines.push_back(line);
+    }
+  }
+
+  if (selected(options, "Dictionary::getId")) {
+    results.push_back(measure("Dictionary::getId", 0, vocab, options.minTime,
+      [&](int64_t i) {
+        sink = sink + dict->getId(words[i % NSAMPLES]);
+      }));
+  }
+  if (selected(options, "Dictionary::getLine")) {
+    std::istringstream in(corpus);
+    results.push_back(measure("Dictionary::getLine", 0, vocab, options.minTime,
+      [&](int64_t i) {
+        sink = sink + dict->getLine(in, line, labels, rng);
+      }));
+  }
+  if (selected(options, "Dictionary::addNgrams")) {
+    results.push_back(measure("Dictionary::addNgrams", 0, vocab, options.minTime,
+      [&](int64_t i) {
+        line = lines[i % NSAMPLES];
+        dict->addNgrams(line, args->wordNgrams, args->dropoutK, rng);
+        sink = sink + line.size();
+      }));
+  }
+
+  for (auto dim = options.dims.cbegin(); dim != options.dims.cend(); ++dim) {
+    args->dim = *dim;
+    std::shared_ptr<Matrix> input =
+      std::make_shared<Matrix>(dict->nwords() + args->bucket, args->dim);
+    std::shared_ptr<Matrix> output =
+      std::make_shared<Matrix>(dict->nwords(), args->dim);
+    input->uniform(1.0 / args->dim);
+    output->uniform(1.0 / args->dim);
+    Vector vec(args->dim);
+    vec.zero();
+
+    if (selected(options, "Vector::addRow")) {
+      results.push_back(measure("Vector::addRow", *dim, vocab, options.minTime,
+        [&](int64_t i) {
+          vec.addRow(*input, ids[i % NSAMPLES]);
+        }));
+      sink = sink + vec[0];
+    }
+    if (selected(options, "Matrix::dotRow")) {
+      results.push_back(measure("Matrix::dotRow", *dim, vocab, options.minTime,
+        [&](int64_t i) {
+          sink = sink + input->dotRow(vec, ids[i % NSAMPLES]);
+        }));
+    }
+    if (selected(options, "ProductQuantizer::mulcode")) {
+      // 512 training rows keep k-means short; codes only for the samples
+      ProductQuantizer pq(args->dim, 2);
+      pq.train(512, input->data_);
+      std::vector<uint8_t> codes(NSAMPLES * ((args->dim + 1) / 2));
+      std::vector<real> rows(NSAMPLES * args->dim);
+      for (int32_t i = 0; i < NSAMPLES; i++) {
+        memcpy(&rows[i * args->dim], &input->data_[ids[i] * args->dim],
+               args->dim * sizeof(real));
+      }
+      pq.compute_codes(rows.data(), codes.data(), NSAMPLES);
+      results.push_back(measure("ProductQuantizer::mulcode", *dim, vocab,
+                                options.minTime,
+        [&](int64_t i) {
+          sink = sink + pq.mulcode(vec, codes.data(), i % NSAMPLES, 1.0);
+        }));
+    }
+    if (selected(options, "Model::update")) {
+      Model model(input, output, args, 0);
+      model.setTargetCounts(dict->getCounts(entry_type::word));
+      results.push_back(measure("Model::update", *dim, vocab, options.minTime,
+        [&](int64_t i) {
+          model.update(lines[i % NSAMPLES], ids[i % NSAMPLES], 0.1);
+        }));
+      sink = sink + model.getLoss();
+    }
+  }
+}
+
+}
+
+void corpus(int argc, char** argv) {
+  int64_t sentences = 1000000;
+  int32_t vocab = 100000;
+  int32_t length = 20;
+  double exponent = 1.0;
+  int32_t seed = 0;
+  for (int ai = 2; ai < argc; ai += 2) {
+    if (ai + 1 >= argc) {
+      printCorpusUsage();
+      exit(EXIT_FAILURE);
+    }
+    if (strcmp(argv[ai], "-sentences") == 0) {
+      sentences = atoll(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-vocab") == 0) {
+      vocab = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-length") == 0) {
+      length = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-zipf") == 0) {
+      exponent = atof(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-seed") == 0) {
+      seed = atoi(argv[ai + 1]);
+    } else {
+      printCorpusUsage();
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (vocab <= 0 || length <= 0) {
+    printCorpusUsage();
+    exit(EXIT_FAILURE);
+  }
+  std::ios_base::sync_with_stdio(false);
+  std::minstd_rand rng(seed);
+  writeCorpus(std::cout, vocab, sentences, length, exponent, rng);
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1 && strcmp(argv[1], "corpus") == 0) {
+    corpus(argc, argv);
+    return 0;
+  }
+  Options options;
+  options.dims = {100, 300, 700};
+  options.vocabs = {10000, 100000};
+  options.bucket = 100000;
+  options.minTime = 0.2;
+  for (int ai = 1; ai < argc; ai += 2) {
+    if (ai + 1 >= argc) {
+      printUsage();
+      exit(EXIT_FAILURE);
+    }
+    if (strcmp(argv[ai], "-dim") == 0) {
+      options.dims = parseList(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-vocab") == 0) {
+      options.vocabs = parseList(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-bucket") == 0) {
+      options.bucket = atoi(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-minTime") == 0) {
+      options.minTime = atof(argv[ai + 1]);
+    } else if (strcmp(argv[ai], "-filter") == 0) {
+      options.filter = argv[ai + 1];
+    } else {
+      printUsage();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  std::vector<Result> results;
+  for (auto it = options.vocabs.cbegin(); it != options.vocabs.cend(); ++it) {
+    runVocab(options, *it, results);
+  }
+
+  std::cout << "{\"min_time\": " << options.minTime
+            << ", \"bucket\": " << options.bucket
+            << ", \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    std::cout << (i > 0 ? ",\n  " : "\n  ")
+              << "{\"name\": \"" << r.name << "\""
+              << ", \"dim\": " << r.dim
+              << ", \"vocab\": " << r.vocab
+              << ", \"iterations\": " << r.iterations
+              << ", \"ns_per_op\": " << r.nsPerOp << "}";
+  }
+  std::cout << "\n]}" << std::endl;
+  return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "cache.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+namespace fasttext {
+
+VectorCache::VectorCache(int64_t dim, size_t bytes) : dim_(dim) {
+  // keys, reference bit and hash map node per entry, on top of the values
+  const size_t entry = dim * sizeof(real) + 72;
+  capacity_ = std::max<int64_t>(1, bytes / entry / NSHARDS);
+  for (int32_t i = 0; i < NSHARDS; i++) {
+    shards_[i].index.reserve(capacity_);
+    shards_[i].hand = 0;
+    shards_[i].hits = 0;
+    shards_[i].misses = 0;
+  }
+}
+
+// FNV-1a for the index and a polynomial hash with another multiplier and
+// finalizer for the check, so that they do not collide together
+VectorCache::Key VectorCache::hash(const std::vector<int32_t>& line) {
+  uint64_t h = 14695981039346656037ULL;
+  uint64_t c = line.size();
+  for (auto it = line.cbegin(); it != line.cend(); ++it) {
+    h ^= uint32_t(*it);
+    h *= 1099511628211ULL;
+    c = c * 0x9e3779b97f4a7c15ULL + uint32_t(*it) + 1;
+  }
+  h ^= line.size();
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  c ^= c >> 30;
+  c *= 0xbf58476d1ce4e5b9ULL;
+  c ^= c >> 27;
+  c *= 0x94d049bb133111ebULL;
+  c ^= c >> 31;
+  return Key{h, c};
+}
+
+VectorCache::Shard& VectorCache::shard(uint64_t key) {
+  return shards_[key % NSHARDS];
+}
+
+bool VectorCache::get(const Key& key, Vector& vec) {
+  assert(vec.size() == dim_);
+  Shard& s = shard(key.hash);
+  std::lock_guard<std::mutex> lock(s.mutex);
+  auto it = s.index.find(key.hash);
+  if (it == s.index.end() || s.checks[it->second] != key.check) {
+    s.misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  s.referenced[it->second] = true;
+  std::copy(s.values.begin() + it->second * dim_,
+            s.values.begin() + (it->second + 1) * dim_, vec.data_);
+  s.hits.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void VectorCache::put(const Key& key, const Vector& vec) {
+  assert(vec.size() == dim_);
+  Shard& s = shard(key.hash);
+  std::lock_guard<std::mutex> lock(s.mutex);
+  auto it = s.index.find(key.hash);
+  if (it != s.index.end()) {
+    // a colliding entry gives way to the newer sentence
+    const int64_t slot = it->second;
+    if (s.checks[slot] != key.check) {
+      s.checks[slot] = key.check;
+      std::copy(vec.data_, vec.data_ + dim_, s.values.begin() + slot * dim_);
+    }
+    return;
+  }
+  int64_t slot;
+  if (s.keys.size() < capacity_) {
+    slot = s.keys.size();
+    s.keys.push_back(key.hash);
+    s.checks.push_back(key.check);
+    s.referenced.push_back(false);
+    s.values.resize((slot + 1) * dim_);
+  } else {
+    while (s.referenced[s.hand]) {
+      s.referenced[s.hand] = false;
+      s.hand = (s.hand + 1) % capacity_;
+    }
+    slot = s.hand;
+    s.hand = (s.hand + 1) % capacity_;
+    s.index.erase(s.keys[slot]);
+    s.keys[slot] = key.hash;
+    s.checks[slot] = key.check;
+  }
+  s.index[key.hash] = slot;
+  std::copy(vec.data_, vec.data_ + dim_, s.values.begin() + slot * dim_);
+}
+
+int64_t VectorCache::hits() const {
+  int64_t n = 0;
+  for (int32_t i = 0; i < NSHARDS; i++) {
+    n += shards_[i].hits.load(std::memory_order_relaxed);
+  }
+  return n;
+}
+
+int64_t VectorCache::misses() const {
+  int64_t n = 0;
+  for (int32_t i = 0; i < NSHARDS; i++) {
+    n += shards_[i].misses.load(std::memory_order_relaxed);
+  }
+  return n;
+}
+
+int64_t VectorCache::size() {
+  int64_t n = 0;
+  for (int32_t i = 0; i < NSHARDS; i++) {
+    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+    n += shards_[i].keys.size();
+  }
+  return n;
+}
+
+}
@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_CACHE_H
+#define FASTTEXT_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "real.h"
+#include "vector.h"
+
+namespace fasttext {
+
+// Fixed-budget cache of sentence vectors keyed by a hash of the token ids.
+// Each entry also keeps a second, independent hash that is compared on
+// lookup, so that a collision of the first one is a miss. Entries are spread
+// over lock-striped shards, each evicting with CLOCK and counting its own
+// hits and misses.
+class VectorCache {
+  public:
+    struct Key {
+      uint64_t hash;
+      uint64_t check;
+    };
+
+  private:
+    static const int32_t NSHARDS = 64;
+
+    struct Shard {
+      std::mutex mutex;
+      std::atomic<int64_t> hits;
+      std::atomic<int64_t> misses;
+      std::unordered_map<uint64_t, int64_t> index;
+      std::vector<uint64_t> keys;
+      std::vector<uint64_t> checks;
+      std::vector<bool> referenced;
+      std::vector<real> values;
+      int64_t hand;
+    };
+
+    int64_t dim_;
+    int64_t capacity_;
+    Shard shards_[NSHARDS];
+
+    Shard& shard(uint64_t);
+
+  public:
+    VectorCache(int64_t, size_t);
+
+    static Key hash(const std::vector<int32_t>&);
+
+    bool get(const Key&, Vector&);
+    void put(const Key&, const Vector&);
+
+    int64_t hits() const;
+    int64_t misses() const;
+    int64_t size();
+};
+
+}
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "cmatrix.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils.h"
+
+namespace fasttext {
+
+CMatrix::CMatrix() : storage_(storage_name::fp16), m_(0), n_(0) {}
+
+CMatrix::CMatrix(const Matrix& mat, storage_name storage)
+      : storage_(storage), m_(mat.m_), n_(mat.n_) {
+  compress(mat);
+}
+
+int64_t CMatrix::getM() const {
+  return m_;
+}
+
+int64_t CMatrix::getN() const {
+  return n_;
+}
+
+storage_name CMatrix::getStorage() const {
+  return storage_;
+}
+
+void CMatrix::compress(const Matrix& mat) {
+  assert(m_ == mat.m_);
+  assert(n_ == mat.n_);
+  halfs_.clear();
+  codes_.clear();
+  scales_.clear();
+  if (storage_ == storage_name::fp16 || storage_ == storage_name::bf16) {
+    halfs_.resize(m_ * n_);
+    for (int64_t i = 0; i < m_ * n_; i++) {
+      halfs_[i] = (storage_ == storage_name::fp16) ?
+        utils::floatToHalf(mat.data_[i]) : utils::floatToBfloat(mat.data_[i]);
+    }
+  } else {
+    assert(storage_ == storage_name::int8);
+    codes_.resize(m_ * n_);
+    scales_.resize(m_);
+    for (int64_t i = 0; i < m_; i++) {
+      real amax = 0.0;
+      for (int64_t j = 0; j < n_; j++) {
+        amax = std::max(amax, std::abs(mat.at(i, j)));
+      }
+      real scale = amax / 127;
+      real inv = (scale > 0) ? 1.0 / scale : 0.0;
+      for (int64_t j = 0; j < n_; j++) {
+        codes_[i * n_ + j] = int8_t(std::lround(mat.at(i, j) * inv));
+      }
+      scales_[i] = scale;
+    }
+  }
+}
+
+void CMatrix::addToVector(Vector& x, int64_t t, real a) const {
+  assert(t >= 0);
+  assert(t < m_);
+  assert(x.size() == n_);
+  real* data = x.data_;
+  if (storage_ == storage_name::fp16) {
+    const uint16_t* row = &halfs_[t * n_];
+    for (int64_t j = 0; j < n_; j++) {
+      data[j] += a * utils::halfToFloat(row[j]);
+    }
+  } else if (storage_ == storage_name::bf16) {
+    const uint16_t* row = &halfs_[t * n_];
+    for (int64_t j = 0; j < n_; j++) {
+      data[j] += a * utils::bfloatToFloat(row[j]);
+    }
+  } else {
+    const int8_t* row = &codes_[t * n_];
+    const real s = a * scales_[t];
+    for (int64_t j = 0; j < n_; j++) {
+      data[j] += s * row[j];
+    }
+  }
+}
+
+real CMatrix::dotRow(const Vector& vec, int64_t i) const {
+  assert(i >= 0);
+  assert(i < m_);
+  assert(vec.size() == n_);
+  const real* data = vec.data_;
+  real d = 0.0;
+  if (storage_ == storage_name::fp16) {
+    const uint16_t* row = &halfs_[i * n_];
+    for (int64_t j = 0; j < n_; j++) {
+      d += utils::halfToFloat(row[j]) * data[j];
+    }
+  } else if (storage_ == storage_name::bf16) {
+    const uint16_t* row = &halfs_[i * n_];
+    for (int64_t j = 0; j < n_; j++) {
+      d += utils::bfloatToFloat(row[j]) * data[j];
+    }
+  } else {
+    const int8_t* row = &codes_[i * n_];
+    for (int64_t j = 0; j < n_; j++) {
+      d += row[j] * data[j];
+    }
+    d *= scales_[i];
+  }
+  return d;
+}
+
+void CMatrix::save(std::ostream& out) {
+  out.write((char*) &storage_, sizeof(storage_));
+  out.write((char*) &m_, sizeof(m_));
+  out.write((char*) &n_, sizeof(n_));
+  if (storage_ == storage_name::int8) {
+    out.write((char*) codes_.data(), m_ * n_ * sizeof(int8_t));
+    out.write((char*) scales_.data(), m_ * sizeof(real));
+  } else {
+    out.write((char*) halfs_.data(), m_ * n_ * sizeof(uint16_t));
+  }
+}
+
+void CMatrix::load(std::istream& in) {
+  in.read((char*) &storage_, sizeof(storage_));
+  in.read((char*) &m_, sizeof(m_));
+  in.read((char*) &n_, sizeof(n_));
+  halfs_.clear();
+  codes_.clear();
+  scales_.clear();
+  if (storage_ == storage_name::int8) {
+    codes_.resize(m_ * n_);
+    scales_.resize(m_);
+    in.read((char*) codes_.data(), m_ * n_ * sizeof(int8_t));
+    in.read((char*) scales_.data(), m_ * sizeof(real));
+  } else {
+    halfs_.resize(m_ * n_);
+    in.read((char*) halfs_.data(), m_ * n_ * sizeof(uint16_t));
+  }
+}
+
+}
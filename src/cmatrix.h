@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_CMATRIX_H
+#define FASTTEXT_CMATRIX_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+#include <vector>
+
+#include "args.h"
+#include "real.h"
+
+#include "matrix.h"
+#include "vector.h"
+
+namespace fasttext {
+
+// Read-only matrix stored with 16-bit floats (fp16, bf16) or with 8-bit
+// integers and one scale per row (int8). Rows are widened to real on the fly.
+class CMatrix {
+  private:
+    storage_name storage_;
+
+    int64_t m_;
+    int64_t n_;
+
+    std::vector<uint16_t> halfs_;
+    std::vector<int8_t> codes_;
+    std::vector<real> scales_;
+
+  public:
+
+    CMatrix();
+    CMatrix(const Matrix&, storage_name);
+
+    int64_t getM() const;
+    int64_t getN() const;
+    storage_name getStorage() const;
+
+    void compress(const Matrix&);
+
+    void addToVector(Vector& x, int64_t t, real a = 1.0) const;
+    real dotRow(const Vector&, int64_t) const;
+
+    void save(std::ostream&);
+    void load(std::istream&);
+};
+
+}
+
+#endif
@@ -10,7 +10,9 @@
 #include "dictionary.h"
 
 #include <assert.h>
+#include <string.h>
 
+#include <atomic>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
@@ -23,18 +25,172 @@ const std::string Dictionary::EOS = "</s>";
 const std::string Dictionary::BOW = "<";
 const std::string Dictionary::EOW = ">";
 
+namespace {
+
+// Recently seen tokens of the calling thread, in front of word2int_. An entry
+// is only valid for the dictionary state tagged by the same version.
+struct TokenCacheEntry {
+  uint64_t version;
+  uint32_t hash;
+  int32_t wid;
+  std::string token;
+};
+
+std::atomic<uint64_t> tokenCacheVersion(1);
+
+// Access to the get area of any stream buffer, so that tokens can be scanned
+// in place instead of being extracted one character at a time.
+class GetArea : public std::streambuf {
+  public:
+    static const char* begin(std::streambuf& sb) {
+      return (sb.*&GetArea::gptr)();
+    }
+
+    static const char* end(std::streambuf& sb) {
+      return (sb.*&GetArea::egptr)();
+    }
+
+    static void advance(std::streambuf& sb, size_t n) {
+      (sb.*&GetArea::gbump)(int(n));
+    }
+};
+
+// Consumes n characters that were scanned in the get area, or at most the
+// single character that was peeked at when there is none
+void skip(std::streambuf& sb, bool buffered, size_t n) {
+  if (buffered) {
+    GetArea::advance(sb, n);
+  } else if (n > 0) {
+    sb.sbumpc();
+  }
+}
+
+// Characters that separate tokens
+struct Delimiters {
+  bool table[256];
+
+  Delimiters() {
+    memset(table, 0, sizeof(table));
+    const char* delimiters = " \n\r\t\v\f";
+    for (const char* c = delimiters; *c; c++) {
+      table[uint8_t(*c)] = true;
+    }
+    table[0] = true;
+  }
+
+  bool operator()(char c) const {
+    return table[uint8_t(c)];
+  }
+};
+
+const Delimiters isDelimiter;
+
+// First delimiter in [p, end), or end. All delimiters are below '!', so
+// eight bytes at a time are first tested for any byte below it.
+const char* findDelimiter(const char* p, const char* end) {
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t highs = 0x8080808080808080ULL;
+  while (end - p >= 8) {
+    uint64_t x;
+    memcpy(&x, p, 8);
+    if (((x - ones * '!') & ~x & highs) != 0) {
+      const char* stop = p + 8;
+      while (p < stop && !isDelimiter(*p)) {
+        p++;
+      }
+      if (p < stop) {
+        return p;
+      }
+    } else {
+      p += 8;
+    }
+  }
+  while (p < end && !isDelimiter(*p)) {
+    p++;
+  }
+  return p;
+}
+
+// Hash of a token for word2int_ and the token cache, eight bytes at a time.
+// It is never saved, unlike the FNV-1a hash behind the bucket ids of word
+// and character n-grams, and is free to differ from it.
+uint32_t vocabHash(const char* w, size_t n) {
+  const uint64_t k0 = 0x9e3779b97f4a7c15ULL;
+  const uint64_t k1 = 0xff51afd7ed558ccdULL;
+  uint64_t h = n * k0;
+  while (n >= 8) {
+    uint64_t x;
+    memcpy(&x, w, 8);
+    h = (h ^ x) * k1;
+    h ^= h >> 29;
+    w += 8;
+    n -= 8;
+  }
+  if (n > 0) {
+    uint64_t x = 0;
+    for (size_t i = 0; i < n; i++) {
+      x |= uint64_t(uint8_t(w[i])) << (8 * i);
+    }
+    h = (h ^ x) * k1;
+  }
+  h ^= h >> 32;
+  h *= k0;
+  h ^= h >> 29;
+  return uint32_t(h);
+}
+
+// FNV-1a, extended one byte at a time
+const uint32_t FNV_OFFSET = 2166136261;
+
+uint32_t fnv(uint32_t h, char c) {
+  return (h ^ uint32_t(c)) * 16777619;
+}
+
+bool isContinuation(char c) {
+  return (c & 0xC0) == 0x80;
+}
+
+bool equals(const std::string& s, const char* w, size_t n) {
+  return s.size() == n && memcmp(s.data(), w, n) == 0;
+}
+
+}
+
 Dictionary::Dictionary(std::shared_ptr<Args> args) : args_(args),
   word2int_(MAX_VOCAB_SIZE, -1), size_(0), nwords_(0), nlabels_(0),
-  ntokens_(0) {}
+  ntokens_(0) {
+  invalidateTokenCache();
+}
+
+void Dictionary::invalidateTokenCache() {
+  version_ = tokenCacheVersion++;
+}
 
 int32_t Dictionary::find(const std::string& w) const {
-  int32_t h = hash(w) % MAX_VOCAB_SIZE;
-  while (word2int_[h] != -1 && words_[word2int_[h]].word != w) {
+  return find(w.data(), w.size(), vocabHash(w.data(), w.size()));
+}
+
+int32_t Dictionary::find(const char* w, size_t n, uint32_t hw) const {
+  int32_t h = hw % MAX_VOCAB_SIZE;
+  while (word2int_[h] != -1 && !equals(words_[word2int_[h]].word, w, n)) {
     h = (h + 1) % MAX_VOCAB_SIZE;
   }
   return h;
 }
 
+int32_t Dictionary::lookup(const char* w, size_t n, uint32_t hw) const {
+  static thread_local std::vector<TokenCacheEntry> cache(TOKEN_CACHE_SIZE);
+  TokenCacheEntry& e = cache[hw % TOKEN_CACHE_SIZE];
+  if (e.version == version_ && e.hash == hw && equals(e.token, w, n)) {
+    return e.wid;
+  }
+  e.version = version_;
+  e.hash = hw;
+  e.wid = word2int_[find(w, n, hw)];
+  e.token.assign(w, n);
+  return e.wid;
+}
+
 void Dictionary::add(const std::string& w) {
   int32_t h = find(w);
   ntokens_++;
@@ -45,6 +201,7 @@ void Dictionary::add(const std::string& w) {
     e.type = getType(w);
     words_.push_back(e);
     word2int_[h] = size_++;
+    invalidateTokenCache();
   } else {
     words_[word2int_[h]].count++;
   }
@@ -113,7 +270,13 @@ entry_type Dictionary::getType(int32_t id) const {
 }
 
 entry_type Dictionary::getType(const std::string& w) const {
-  return (w.find(args_->label) == 0) ? entry_type::label : entry_type::word;
+  return getType(w.data(), w.size());
+}
+
+entry_type Dictionary::getType(const char* w, size_t n) const {
+  const std::string& label = args_->label;
+  return (n >= label.size() && memcmp(w, label.data(), label.size()) == 0) ?
+    entry_type::label : entry_type::word;
 }
 
 std::string Dictionary::getWord(int32_t id) const {
@@ -135,29 +298,34 @@ real Dictionary::getPDiscard(int32_t id) const {
 }
 
 uint32_t Dictionary::hash(const std::string& str) const {
-  uint32_t h = 2166136261;
-  for (size_t i = 0; i < str.size(); i++) {
-    h = h ^ uint32_t(str[i]);
-    h = h * 16777619;
+  return hash(str.data(), str.size());
+}
+
+uint32_t Dictionary::hash(const char* str, size_t n) const {
+  uint32_t h = FNV_OFFSET;
+  for (size_t i = 0; i < n; i++) {
+    h = fnv(h, str[i]);
   }
   return h;
 }
 
+// The hash of each n-gram extends the hash of the n-gram one code point
+// shorter that starts at the same position, which gives the same value as
+// hashing the n-gram on its own.
 void Dictionary::computeNgrams(const std::string& word,
                                std::vector<int32_t>& ngrams,
                                std::vector<std::string>& substrings) const {
   for (size_t i = 0; i < word.size(); i++) {
-    std::string ngram;
-    if ((word[i] & 0xC0) == 0x80) continue;
+    if (isContinuation(word[i])) continue;
+    uint32_t h = FNV_OFFSET;
     for (size_t j = i, n = 1; j < word.size() && n <= args_->maxn; n++) {
-      ngram.push_back(word[j++]);
-      while (j < word.size() && (word[j] & 0xC0) == 0x80) {
-        ngram.push_back(word[j++]);
+      h = fnv(h, word[j++]);
+      while (j < word.size() && isContinuation(word[j])) {
+        h = fnv(h, word[j++]);
       }
       if (n >= args_->minn && !(n == 1 && (i == 0 || j == word.size()))) {
-        int32_t h = hash(ngram) % args_->bucket;
-        ngrams.push_back(nwords_ + h);
-        substrings.push_back(ngram);
+        ngrams.push_back(nwords_ + h % args_->bucket);
+        substrings.push_back(word.substr(i, j - i));
       }
     }
   }
@@ -166,24 +334,26 @@ void Dictionary::computeNgrams(const std::string& word,
 void Dictionary::computeNgrams(const std::string& word,
                                std::vector<int32_t>& ngrams) const {
   for (size_t i = 0; i < word.size(); i++) {
-    std::string ngram;
-    if ((word[i] & 0xC0) == 0x80) continue;
+    if (isContinuation(word[i])) continue;
+    uint32_t h = FNV_OFFSET;
     for (size_t j = i, n = 1; j < word.size() && n <= args_->maxn; n++) {
-      ngram.push_back(word[j++]);
-      while (j < word.size() && (word[j] & 0xC0) == 0x80) {
-        ngram.push_back(word[j++]);
+      h = fnv(h, word[j++]);
+      while (j < word.size() && isContinuation(word[j])) {
+        h = fnv(h, word[j++]);
       }
       if (n >= args_->minn && !(n == 1 && (i == 0 || j == word.size()))) {
-        int32_t h = hash(ngram) % args_->bucket;
-        ngrams.push_back(nwords_ + h);
+        ngrams.push_back(nwords_ + h % args_->bucket);
       }
     }
   }
 }
 
 void Dictionary::initNgrams() {
+  std::string word;
   for (size_t i = 0; i < size_; i++) {
-    std::string word = BOW + words_[i].word + EOW;
+    word.assign(BOW);
+    word.append(words_[i].word);
+    word.append(EOW);
     words_[i].subwords.push_back(i);
     computeNgrams(word, words_[i].subwords);
   }
@@ -191,29 +361,80 @@ void Dictionary::initNgrams() {
 
 bool Dictionary::readWord(std::istream& in, std::string& word) const
 {
-  char c;
+  const char* data;
+  size_t size;
+  if (!readWord(in, data, size, word)) {
+    return false;
+  }
+  if (data != word.data()) {
+    word.assign(data, size);
+  }
+  return true;
+}
+
+// The token is [data, data + size). It points into the buffer of the stream
+// when it lies there in one piece, and into spill when it spans a refill or
+// the stream has no buffer. Either way it is valid until the next read.
+bool Dictionary::readWord(std::istream& in, const char*& data, size_t& size,
+                          std::string& spill) const
+{
   std::streambuf& sb = *in.rdbuf();
-  word.clear();
-  while ((c = sb.sbumpc()) != EOF) {
-    if (c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' ||
-        c == '\f' || c == '\0') {
-      if (word.empty()) {
-        if (c == '\n') {
-          word += EOS;
-          return true;
-        }
-        continue;
-      } else {
-        if (c == '\n')
-          sb.sungetc();
+  spill.clear();
+  while (true) {
+    const char* begin = GetArea::begin(sb);
+    const char* end = GetArea::end(sb);
+    char c;
+    bool buffered = begin != end;
+    if (!buffered) {
+      int next = sb.sgetc();
+      if (next == EOF) {
+        break;
+      }
+      begin = GetArea::begin(sb);
+      end = GetArea::end(sb);
+      buffered = begin != end;
+      if (!buffered) {
+        // e.g. std::cin synced with stdio: look at one character at a time
+        c = char(next);
+        begin = &c;
+        end = begin + 1;
+      }
+    }
+    const char* p = begin;
+    if (spill.empty()) {
+      while (p < end && isDelimiter(*p) && *p != '\n') {
+        p++;
+      }
+      if (p < end && *p == '\n') {
+        skip(sb, buffered, p + 1 - begin);
+        data = EOS.data();
+        size = EOS.size();
         return true;
       }
     }
-    word.push_back(c);
+    const char* token = p;
+    p = findDelimiter(p, end);
+    if (p < end) {
+      if (spill.empty()) {
+        data = token;
+        size = p - token;
+      } else {
+        spill.append(token, p);
+        data = spill.data();
+        size = spill.size();
+      }
+      // leave a newline for the next call to return as EOS
+      skip(sb, buffered, p - begin + (*p != '\n'));
+      return true;
+    }
+    spill.append(token, p);
+    skip(sb, buffered, end - begin);
   }
   // trigger eofbit
   in.get();
-  return !word.empty();
+  data = spill.data();
+  size = spill.size();
+  return size > 0;
 }
 
 void Dictionary::readFromFile(std::istream& in) {
@@ -237,6 +458,7 @@ void Dictionary::readFromFile(std::istream& in) {
     e.type = entry_type::word;
     words_.push_back(e);
     word2int_[h] = size_++;
+    invalidateTokenCache();
   }
   threshold(args_->minCount, args_->minCountLabel);
   initTableDiscard();
@@ -271,6 +493,7 @@ void Dictionary::threshold(int64_t t, int64_t tl) {
   nwords_ = 0;
   nlabels_ = 0;
   std::fill(word2int_.begin(), word2int_.end(), -1);
+  invalidateTokenCache();
   for (auto it = words_.begin(); it != words_.end(); ++it) {
     int32_t h = find(it->word);
     word2int_[h] = size_++;
@@ -364,29 +587,37 @@ int32_t Dictionary::getLine(std::istream& in,
   words.clear();
   labels.clear();
   word_hashes.clear();
+  // only supervised models turn the hashes of words into word n-grams
+  const bool hashes = args_->model == model_name::sup;
   int32_t ntokens = 0;
-  std::string token;
-  while (readWord(in, token)) {
-    if (token == EOS && args_-> model == model_name::sent2vec){
+  std::string spill;
+  const char* token;
+  size_t size;
+  while (readWord(in, token, size, spill)) {
+    const bool eos = size == EOS.size() && memcmp(token, EOS.data(), size) == 0;
+    if (eos && args_-> model == model_name::sent2vec){
        break;
     }
-    int32_t h = find(token);
-    int32_t wid = word2int_[h];
+    int32_t wid = lookup(token, size, vocabHash(token, size));
     if (wid < 0) {
-      entry_type type = getType(token);
-      if (type == entry_type::word) word_hashes.push_back(hash(token));
+      entry_type type = getType(token, size);
+      if (type == entry_type::word && hashes) {
+        word_hashes.push_back(hash(token, size));
+      }
       continue;
     }
     entry_type type = getType(wid);
     ntokens++;
     if (type == entry_type::word && !discard(wid, uniform(rng))) {
       words.push_back(wid);
-      word_hashes.push_back(hash(token));
+      if (hashes) {
+        word_hashes.push_back(hash(token, size));
+      }
     }
     if (type == entry_type::label) {
       labels.push_back(wid - nwords_);
     }
-    if (token == EOS) break;
+    if (eos) break;
     if (ntokens > MAX_LINE_SIZE && args_->model != model_name::sup && args_->model != model_name::sent2vec) break;
   }
   return ntokens;
@@ -432,6 +663,7 @@ void Dictionary::save(std::ostream& out) const {
 void Dictionary::load(std::istream& in) {
   words_.clear();
   std::fill(word2int_.begin(), word2int_.end(), -1);
+  invalidateTokenCache();
   in.read((char*) &size_, sizeof(int32_t));
   in.read((char*) &nwords_, sizeof(int32_t));
   in.read((char*) &nlabels_, sizeof(int32_t));
@@ -480,6 +712,7 @@ void Dictionary::prune(std::vector<int32_t>& idx) {
   pruneidx_size_ = pruneidx_.size();
 
   std::fill(word2int_.begin(), word2int_.end(), -1);
+  invalidateTokenCache();
 
   int32_t j = 0;
   for (int32_t i = 0; i < words_.size(); i++) {
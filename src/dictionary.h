@@ -38,7 +38,13 @@ class Dictionary {
     static const int32_t MAX_VOCAB_SIZE = 30000000;
     static const int32_t MAX_LINE_SIZE = 1024;
 
+    static const int32_t TOKEN_CACHE_SIZE = 4096;
+
     int32_t find(const std::string&) const;
+    int32_t find(const char*, size_t, uint32_t) const;
+    int32_t lookup(const char*, size_t, uint32_t) const;
+    entry_type getType(const char*, size_t) const;
+    void invalidateTokenCache();
     void initTableDiscard();
     void initNgrams();
 
@@ -52,6 +58,8 @@ class Dictionary {
     int32_t nlabels_;
     int64_t ntokens_;
 
+    uint64_t version_;
+
     int64_t pruneidx_size_ = -1;
     std::unordered_map<int32_t, int32_t> pruneidx_;
     void addNgrams(
@@ -83,8 +91,10 @@ class Dictionary {
     void computeNgrams(const std::string&, std::vector<int32_t>&,
                        std::vector<std::string>&) const;
     uint32_t hash(const std::string& str) const;
+    uint32_t hash(const char*, size_t) const;
     void add(const std::string&);
     bool readWord(std::istream&, std::string&) const;
+    bool readWord(std::istream&, const char*&, size_t&, std::string&) const;
     void readFromFile(std::istream&);
     std::string getLabel(int32_t) const;
     void save(std::ostream&) const;
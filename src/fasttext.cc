@@ -19,18 +19,39 @@
 #include <vector>
 #include <queue>
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <stdio.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
 namespace fasttext {
 
-FastText::FastText() : quant_(false) {}
+FastText::FastText() : tokenCount(0), startTokenCount_(0), start(0),
+  checkpointRequest_(0), trainDone_(false), quant_(false),
+  compressed_(false) {}
+
+void FastText::addInputRow(Vector& vec, int32_t i) const {
+  if (quant_) {
+    vec.addRow(*qinput_, i);
+  } else if (compressed_) {
+    vec.addRow(*cinput_, i);
+  } else {
+    vec.addRow(*input_, i);
+  }
+}
 
 void FastText::getVector(Vector& vec, const std::string& word) const {
   const std::vector<int32_t>& ngrams = dict_->getNgrams(word);
   vec.zero();
   for (auto it = ngrams.begin(); it != ngrams.end(); ++it) {
-    vec.addRow(*input_, *it);
+    addInputRow(vec, *it);
   }
   if (ngrams.size() > 0) {
     vec.mul(1.0 / ngrams.size());
@@ -93,7 +114,7 @@ void FastText::signModel(std::ostream& out) {
 
 void FastText::saveModel() {
   std::string fn(args_->output);
-  if (quant_) {
+  if (quant_ || compressed_) {
     fn += ".ftz";
   } else {
     fn += ".bin";
@@ -107,9 +128,17 @@ void FastText::saveModel() {
   args_->save(ofs);
   dict_->save(ofs);
 
-  ofs.write((char*)&(quant_), sizeof(bool));
+  storage_name storage = storage_name::fp32;
+  if (quant_) {
+    storage = storage_name::pq;
+  } else if (compressed_) {
+    storage = cinput_->getStorage();
+  }
+  ofs.write((char*)&(storage), sizeof(storage_name));
   if (quant_) {
     qinput_->save(ofs);
+  } else if (compressed_) {
+    cinput_->save(ofs);
   } else {
     input_->save(ofs);
   }
@@ -124,7 +153,7 @@ void FastText::saveModel() {
   ofs.close();
 }
 
-void FastText::loadModel(const std::string& filename) {
+void FastText::loadModel(const std::string& filename, bool lazy) {
   std::ifstream ifs(filename, std::ifstream::binary);
   if (!ifs.is_open()) {
     std::cerr << "Model file cannot be opened for loading!" << std::endl;
@@ -134,26 +163,38 @@ void FastText::loadModel(const std::string& filename) {
     std::cerr << "Model file has wrong file format!" << std::endl;
     exit(EXIT_FAILURE);
   }
-  loadModel(ifs);
+  loadModel(ifs, lazy ? filename : "");
   ifs.close();
 }
 
-void FastText::loadModel(std::istream& in) {
+void FastText::loadModel(std::istream& in, const std::string& mapFilename) {
   args_ = std::make_shared<Args>();
   dict_ = std::make_shared<Dictionary>(args_);
   input_ = std::make_shared<Matrix>();
   output_ = std::make_shared<Matrix>();
   qinput_ = std::make_shared<QMatrix>();
   qoutput_ = std::make_shared<QMatrix>();
+  cinput_ = std::make_shared<CMatrix>();
   args_->load(in);
 
   dict_->load(in);
 
-  bool quant_input;
-  in.read((char*) &quant_input, sizeof(bool));
-  if (quant_input) {
+  storage_name storage;
+  in.read((char*) &storage, sizeof(storage_name));
+  quant_ = false;
+  compressed_ = false;
+  if (storage == storage_name::pq) {
     quant_ = true;
     qinput_->load(in);
+  } else if (storage == storage_name::fp16 || storage == storage_name::bf16 ||
+             storage == storage_name::int8) {
+    compressed_ = true;
+    cinput_->load(in);
+  } else if (storage != storage_name::fp32) {
+    std::cerr << "Model file has unknown storage!" << std::endl;
+    exit(EXIT_FAILURE);
+  } else if (!mapFilename.empty()) {
+    input_->loadMapped(in, mapFilename);
   } else {
     input_->load(in);
   }
@@ -168,6 +209,9 @@ void FastText::loadModel(std::istream& in) {
   model_ = std::make_shared<Model>(input_, output_, args_, 0);
   model_->quant_ = quant_;
   model_->setQuantizePointer(qinput_, qoutput_, args_->qout);
+  if (compressed_) {
+    model_->setCompressedPointer(cinput_);
+  }
 
   if (args_->model == model_name::sup) {
     model_->setTargetCounts(dict_->getCounts(entry_type::label));
@@ -176,11 +220,29 @@ void FastText::loadModel(std::istream& in) {
   }
 }
 
+int64_t FastText::pinRows(std::istream& in) {
+  if (quant_ || compressed_) {
+    return 0;
+  }
+  std::vector<int32_t> line, labels, rows;
+  while (in.peek() != EOF) {
+    dict_->getLine(in, line, labels, model_->rng);
+    if (args_->model == model_name::sent2vec) {
+      dict_->addNgrams(line, args_->wordNgrams);
+    }
+    rows.insert(rows.end(), line.cbegin(), line.cend());
+  }
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+  return input_->pinRows(rows);
+}
+
 void FastText::printInfo(real progress, real loss) {
   real t = real(clock() - start) / CLOCKS_PER_SEC;
-  real wst = real(tokenCount) / t;
+  real wst = real(tokenCount - startTokenCount_) / t;
   real lr = args_->lr * (1.0 - progress);
-  int eta = int(t / progress * (1 - progress) / args_->thread);
+  real done = progress - real(startTokenCount_) / (args_->epoch * dict_->ntokens());
+  int eta = done > 0 ? int(t / done * (1 - progress) / args_->thread) : 0;
   int etah = eta / 3600;
   int etam = (eta - etah * 3600) / 60;
   std::cerr << std::fixed;
@@ -233,7 +295,8 @@ void FastText::quantize(std::shared_ptr<Args> qargs) {
       args_->lr = qargs->lr;
       args_->thread = qargs->thread;
       args_->verbose = qargs->verbose;
-      tokenCount = 0;
+      resetTrainStates();
+      prepareTraining();
       std::vector<std::thread> threads;
       for (int32_t i = 0; i < args_->thread; i++) {
         threads.push_back(std::thread([=]() { trainThread(i); }));
@@ -244,13 +307,19 @@ void FastText::quantize(std::shared_ptr<Args> qargs) {
     }
   }
 
-  qinput_ = std::make_shared<QMatrix>(*input_, qargs->dsub, qargs->qnorm);
+  if (qargs->storage == storage_name::pq) {
+    qinput_ = std::make_shared<QMatrix>(*input_, qargs->dsub, qargs->qnorm);
 
-  if (args_->qout) {
-    qoutput_ = std::make_shared<QMatrix>(*output_, 2, qargs->qnorm);
-  }
+    if (args_->qout) {
+      qoutput_ = std::make_shared<QMatrix>(*output_, 2, qargs->qnorm);
+    }
 
-  quant_ = true;
+    quant_ = true;
+  } else {
+    cinput_ = std::make_shared<CMatrix>(*input_, qargs->storage);
+    args_->qout = false;
+    compressed_ = true;
+  }
   saveModel();
 }
 
@@ -308,12 +377,57 @@ void FastText::sent2vec(Model& model, real lr, const std::vector<int32_t>& line)
   }
 }
 
-void FastText::test(std::istream& in, int32_t k) {
+void FastText::test(std::istream& in, int32_t k, int32_t threads) {
   int32_t nexamples = 0, nlabels = 0;
   double precision = 0.0;
   std::vector<int32_t> line, labels;
 
-  while (in.peek() != EOF) {
+  if (threads > 1) {
+    // per-thread partial counts, reduced once all lines are processed
+    std::vector<int32_t> texamples(threads, 0), tlabels(threads, 0);
+    std::vector<double> tprecision(threads, 0.0);
+    std::vector<std::minstd_rand> rngs(threads);
+    processLines(in, threads,
+                 [&](int32_t threadId, const std::vector<std::string>& lines,
+                     std::string& out) {
+      // the whole batch goes through the model at once so that hs models
+      // walk the tree a single time for all of its lines
+      std::vector<std::vector<int32_t>> inputs(lines.size());
+      std::vector<std::vector<int32_t>> targets(lines.size());
+      std::vector<std::vector<std::pair<real, int32_t>>> modelPredictions;
+      std::vector<std::shared_ptr<Vector>> hiddens;
+      Vector output(dict_->nlabels());
+      for (int32_t i = 0; i < lines.size(); i++) {
+        std::istringstream iss(lines[i]);
+        dict_->getLine(iss, inputs[i], targets[i], rngs[threadId]);
+        if (targets[i].empty()) {
+          inputs[i].clear();
+        }
+        hiddens.push_back(std::make_shared<Vector>(args_->dim));
+      }
+      model_->predict(inputs, k, modelPredictions, hiddens, output);
+      for (int32_t i = 0; i < lines.size(); i++) {
+        if (inputs[i].empty()) {
+          continue;
+        }
+        const std::vector<int32_t>& labels = targets[i];
+        for (auto pit = modelPredictions[i].cbegin(); pit != modelPredictions[i].cend(); pit++) {
+          if (std::find(labels.begin(), labels.end(), pit->second) != labels.end()) {
+            tprecision[threadId] += 1.0;
+          }
+        }
+        texamples[threadId]++;
+        tlabels[threadId] += labels.size();
+      }
+    }, std::cout);
+    for (int32_t i = 0; i < threads; i++) {
+      nexamples += texamples[i];
+      nlabels += tlabels[i];
+      precision += tprecision[i];
+    }
+  }
+
+  while (threads <= 1 && in.peek() != EOF) {
     dict_->getLine(in, line, labels, model_->rng);
     if (labels.size() > 0 && line.size() > 0) {
       std::vector<std::pair<real, int32_t>> modelPredictions;
@@ -338,6 +452,7 @@ void FastText::predict(std::istream& in, int32_t k,
                        std::vector<std::pair<real,std::string>>& predictions) const {
   std::vector<int32_t> words, labels;
   dict_->getLine(in, words, labels, model_->rng);
+  predictions.clear();
   if (words.empty()) return;
   Vector hidden(args_->dim);
   Vector output(dict_->nlabels());
@@ -349,8 +464,43 @@ void FastText::predict(std::istream& in, int32_t k,
   }
 }
 
-void FastText::predict(std::istream& in, int32_t k, bool print_prob) {
+void FastText::predict(std::istream& in, int32_t k, bool print_prob,
+                       int32_t threads) {
   std::vector<std::pair<real,std::string>> predictions;
+  if (threads > 1) {
+    std::vector<std::minstd_rand> rngs(threads);
+    processLines(in, threads,
+                 [&](int32_t threadId, const std::vector<std::string>& lines,
+                     std::string& out) {
+      std::vector<std::vector<int32_t>> inputs(lines.size());
+      std::vector<int32_t> labels;
+      std::vector<std::vector<std::pair<real, int32_t>>> modelPredictions;
+      std::vector<std::shared_ptr<Vector>> hiddens;
+      Vector output(dict_->nlabels());
+      for (int32_t i = 0; i < lines.size(); i++) {
+        std::istringstream iss(lines[i]);
+        dict_->getLine(iss, inputs[i], labels, rngs[threadId]);
+        hiddens.push_back(std::make_shared<Vector>(args_->dim));
+      }
+      model_->predict(inputs, k, modelPredictions, hiddens, output);
+      std::ostringstream oss;
+      for (int32_t i = 0; i < lines.size(); i++) {
+        const auto& predictions = modelPredictions[i];
+        for (auto pit = predictions.cbegin(); pit != predictions.cend(); pit++) {
+          if (pit != predictions.cbegin()) {
+            oss << " ";
+          }
+          oss << dict_->getLabel(pit->second);
+          if (print_prob) {
+            oss << " " << exp(pit->first);
+          }
+        }
+        oss << '\n';
+      }
+      out = oss.str();
+    }, std::cout);
+    return;
+  }
   while (in.peek() != EOF) {
     predict(in, k, predictions);
     if (predictions.empty()) {
@@ -400,22 +550,58 @@ void FastText::sentenceVectors() {
 }
 
 Vector FastText::singleSentenceVector(std::string& sentence) {
-  std::vector<int32_t> line, labels;
   Vector vec(args_->dim);
   std::istringstream iss(sentence);
-//  while (std::cin.peek() != EOF) {
-  dict_->getLine(iss, line, labels, model_->rng);
+  sentenceVector(iss, vec, model_->rng);
+  return vec;
+}
+
+void FastText::sentenceVector(std::istream& in, Vector& vec,
+                              std::minstd_rand& rng) const {
+  std::vector<int32_t> line;
+  sentenceTokens(in, line, rng);
+  tokensVector(line, vec);
+}
+
+void FastText::sentenceTokens(std::istream& in, std::vector<int32_t>& line,
+                              std::minstd_rand& rng) const {
+  std::vector<int32_t> labels;
+  dict_->getLine(in, line, labels, rng);
+}
+
+void FastText::tokensVector(std::vector<int32_t>& line, Vector& vec) const {
+  VectorCache::Key key = {0, 0};
+  if (cache_) {
+    key = VectorCache::hash(line);
+    if (cache_->get(key, vec)) {
+      return;
+    }
+  }
   vec.zero();
   if (args_->model == model_name::sent2vec){
     dict_->addNgrams(line, args_->wordNgrams);
   }
   for (auto it = line.cbegin(); it != line.cend(); ++it) {
-    vec.addRow(*input_, *it);
+    addInputRow(vec, *it);
   }
   if (!line.empty()) {
     vec.mul(1.0 / line.size());
   }
-  return vec;
+  if (cache_) {
+    cache_->put(key, vec);
+  }
+}
+
+void FastText::setCache(size_t bytes) {
+  if (bytes > 0) {
+    cache_ = std::make_shared<VectorCache>(args_->dim, bytes);
+  } else {
+    cache_.reset();
+  }
+}
+
+std::shared_ptr<const VectorCache> FastText::getCache() const {
+  return cache_;
 }
 
 void FastText::ngramVectors(std::string word) {
@@ -426,13 +612,86 @@ void FastText::ngramVectors(std::string word) {
   for (int32_t i = 0; i < ngrams.size(); i++) {
     vec.zero();
     if (ngrams[i] >= 0) {
-      vec.addRow(*input_, ngrams[i]);
+      addInputRow(vec, ngrams[i]);
     }
     std::cout << substrings[i] << " " << vec << std::endl;
   }
 }
 
-void FastText::textVectors() {
+namespace {
+
+// Header of a .npy file (format version 1.0) holding a rows x dim float32
+// matrix. The row count is padded to a fixed width so that the header can
+// be rewritten in place once the number of rows is known.
+std::string npyHeader(int64_t rows, int64_t dim) {
+  std::ostringstream dict;
+  dict << "{'descr': '<f4', 'fortran_order': False, 'shape': ("
+       << std::setw(20) << rows << ", " << dim << "), }";
+  std::string header = dict.str();
+  size_t total = 10 + header.size() + 1;
+  header.append((64 - total % 64) % 64, ' ');
+  header.push_back('\n');
+  uint16_t len = header.size();
+  std::string magic("\x93NUMPY\x01\x00", 8);
+  magic.push_back(char(len & 0xff));
+  magic.push_back(char(len >> 8));
+  return magic + header;
+}
+
+}
+
+void FastText::textVectors(int32_t threads, format_name format) {
+  if (threads > 1 || format != format_name::text) {
+    int64_t headerPos = 0;
+    if (format == format_name::npy) {
+      struct stat st;
+      headerPos = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+      if (fstat(STDOUT_FILENO, &st) != 0 || !S_ISREG(st.st_mode) ||
+          headerPos < 0 || (fcntl(STDOUT_FILENO, F_GETFL) & O_APPEND)) {
+        std::cerr << "npy output requires stdout to be redirected to a file!"
+                  << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      std::cout << npyHeader(0, args_->dim);
+    }
+    std::vector<std::minstd_rand> rngs(threads);
+    std::atomic<int64_t> rows(0);
+    processLines(std::cin, threads,
+                 [&](int32_t threadId, const std::vector<std::string>& lines,
+                     std::string& out) {
+      Vector vec(args_->dim);
+      std::ostringstream oss;
+      for (auto it = lines.cbegin(); it != lines.cend(); ++it) {
+        std::istringstream iss(*it);
+        sentenceVector(iss, vec, rngs[threadId]);
+        if (format == format_name::text) {
+          oss << vec << '\n';
+        } else if (format == format_name::f16) {
+          for (int64_t j = 0; j < vec.size(); j++) {
+            uint16_t h = utils::floatToHalf(vec[j]);
+            out.append((const char*) &h, sizeof(uint16_t));
+          }
+        } else {
+          out.append((const char*) vec.data_, vec.size() * sizeof(real));
+        }
+      }
+      if (format == format_name::text) {
+        out = oss.str();
+      }
+      rows += lines.size();
+    }, std::cout);
+    if (format == format_name::npy) {
+      std::cout.flush();
+      fflush(stdout);
+      std::string header = npyHeader(rows, args_->dim);
+      if (pwrite(STDOUT_FILENO, header.data(), header.size(), headerPos) !=
+          header.size()) {
+        std::cerr << "Could not write npy header!" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    return;
+  }
   std::vector<int32_t> line, labels;
   Vector vec(args_->dim);
   while (std::cin.peek() != EOF) {
@@ -442,7 +701,7 @@ void FastText::textVectors() {
 	dict_->addNgrams(line, args_->wordNgrams);
     }
     for (auto it = line.cbegin(); it != line.cend(); ++it) {
-      vec.addRow(*input_, *it);
+      addInputRow(vec, *it);
     }
     if (!line.empty()) {
       vec.mul(1.0 / line.size());
@@ -451,13 +710,101 @@ void FastText::textVectors() {
   }
 }
 
+// Runs work over batches of lines from in on the given number of threads
+// and writes the output of each batch to out in input order. Lines are read
+// by a separate thread and at most 4 batches per thread are in flight. A
+// batch ends early when no more input is buffered and out is flushed after
+// each batch, so a caller writing one line at a time gets its answers.
+void FastText::processLines(std::istream& in, int32_t threads,
+                            const std::function<void(int32_t,
+                                                     const std::vector<std::string>&,
+                                                     std::string&)>& work,
+                            std::ostream& out) {
+  const size_t batchSize = 1024;
+  const int64_t maxInFlight = 4 * threads;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::pair<int64_t, std::vector<std::string>>> pending;
+  std::map<int64_t, std::string> done;
+  int64_t nread = 0, nwritten = 0;
+  bool eof = false;
+
+  std::thread reader([&]() {
+    while (true) {
+      std::vector<std::string> lines;
+      std::string line;
+      // hand off a partial batch rather than wait for input that an
+      // interactive caller only sends once it has read our answer
+      while (lines.size() < batchSize &&
+             (lines.empty() || in.rdbuf()->in_avail() > 0) &&
+             std::getline(in, line)) {
+        // keep the newline so that getLine still sees the end of sentence
+        line.push_back('\n');
+        lines.push_back(line);
+      }
+      std::unique_lock<std::mutex> lock(mutex);
+      if (lines.empty()) {
+        eof = true;
+        cv.notify_all();
+        return;
+      }
+      cv.wait(lock, [&]() { return nread - nwritten < maxInFlight; });
+      pending.push_back(std::make_pair(nread++, std::move(lines)));
+      cv.notify_all();
+    }
+  });
+
+  std::vector<std::thread> workers;
+  for (int32_t i = 0; i < threads; i++) {
+    workers.push_back(std::thread([&, i]() {
+      while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return !pending.empty() || eof; });
+        if (pending.empty()) {
+          return;
+        }
+        auto batch = std::move(pending.front());
+        pending.pop_front();
+        lock.unlock();
+        std::string output;
+        work(i, batch.second, output);
+        lock.lock();
+        done[batch.first] = std::move(output);
+        cv.notify_all();
+      }
+    }));
+  }
+
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&]() {
+      return done.count(nwritten) > 0 || (eof && nwritten == nread);
+    });
+    if (done.count(nwritten) == 0) {
+      break;
+    }
+    std::string output = std::move(done[nwritten]);
+    done.erase(nwritten);
+    lock.unlock();
+    out.write(output.data(), output.size());
+    out.flush();
+    lock.lock();
+    nwritten++;
+    cv.notify_all();
+  }
+  reader.join();
+  for (auto it = workers.begin(); it != workers.end(); ++it) {
+    it->join();
+  }
+}
+
 void FastText::printWordVectors() {
   wordVectors();
 }
 
-void FastText::printSentenceVectors() {
+void FastText::printSentenceVectors(int32_t threads, format_name format) {
   if (args_->model == model_name::sup || args_->model == model_name::sent2vec) {
-    textVectors();
+    textVectors(threads, format);
   } else {
     sentenceVectors();
   }
@@ -490,7 +837,7 @@ void FastText::precomputeSentenceVectors(Matrix& sentenceVectors,std::ifstream&
 
     vec.zero();
     for (auto it = line.cbegin(); it != line.cend(); ++it) {
-      vec.addRow(*input_, *it);
+      addInputRow(vec, *it);
     }
     if (!line.empty()) {
       vec.mul(1.0 / line.size());
@@ -630,7 +977,7 @@ void FastText::nnSent(int32_t k, std::string filename) {
     dict_->addNgrams(line, args_->wordNgrams);
     buffer.zero();
     for (auto it = line.cbegin(); it != line.cend(); ++it) {
-      buffer.addRow(*input_, *it);
+      addInputRow(buffer, *it);
     }
     if (!line.empty()) {
       buffer.mul(1.0 / line.size());
@@ -675,7 +1022,7 @@ void FastText::analogiesSent(int32_t k, std::string filename) {
     dict_->addNgrams(line, args_->wordNgrams);
     buffer.zero();
     for (auto it = line.cbegin(); it != line.cend(); ++it) {
-      buffer.addRow(*input_, *it);
+      addInputRow(buffer, *it);
     }
     if (!line.empty()) {
       buffer.mul(1.0 / line.size());
@@ -686,7 +1033,7 @@ void FastText::analogiesSent(int32_t k, std::string filename) {
     dict_->addNgrams(line, args_->wordNgrams);
     buffer.zero();
     for (auto it = line.cbegin(); it != line.cend(); ++it) {
-      buffer.addRow(*input_, *it);
+      addInputRow(buffer, *it);
     }
     if (!line.empty()) {
       buffer.mul(1.0 / line.size());
@@ -698,7 +1045,7 @@ void FastText::analogiesSent(int32_t k, std::string filename) {
     dict_->addNgrams(line, args_->wordNgrams);
     buffer.zero();
     for (auto it = line.cbegin(); it != line.cend(); ++it) {
-      buffer.addRow(*input_, *it);
+      addInputRow(buffer, *it);
     }
     if (!line.empty()) {
       buffer.mul(1.0 / line.size());
@@ -712,11 +1059,163 @@ void FastText::analogiesSent(int32_t k, std::string filename) {
 }
 
 
+void FastText::reportTrainState(int32_t threadId, std::ifstream& ifs,
+                                const Model& model, int64_t tokens) {
+  std::ostringstream rng;
+  rng << model.rng;
+  // unlike tellg, pubseekoff does not fail once eofbit is set
+  int64_t offset = ifs.rdbuf()->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+  {
+    std::lock_guard<std::mutex> lock(checkpointMutex_);
+    TrainState& state = trainStates_[threadId];
+    state.checkpoint = checkpointRequest_;
+    state.offset = offset;
+    state.tokens = tokens;
+    state.rng = rng.str();
+  }
+  checkpointCv_.notify_all();
+}
+
+void FastText::checkpointThread() {
+  auto last = std::chrono::steady_clock::now();
+  int64_t lastTokens = tokenCount;
+  std::unique_lock<std::mutex> lock(checkpointMutex_);
+  while (!trainDone_) {
+    checkpointCv_.wait_for(lock, std::chrono::seconds(1));
+    auto now = std::chrono::steady_clock::now();
+    bool due =
+      (args_->checkpointTokens > 0 &&
+       tokenCount - lastTokens >= args_->checkpointTokens) ||
+      (args_->checkpointMinutes > 0 &&
+       now - last >= std::chrono::minutes(args_->checkpointMinutes));
+    if (trainDone_ || !due) {
+      continue;
+    }
+    // training threads answer at their next lr update, so waiting here
+    // never stalls them; only the write below takes time
+    const int64_t request = ++checkpointRequest_;
+    checkpointCv_.wait(lock, [&]() {
+      if (trainDone_) {
+        return true;
+      }
+      for (auto it = trainStates_.cbegin(); it != trainStates_.cend(); ++it) {
+        if (it->checkpoint < request) {
+          return false;
+        }
+      }
+      return true;
+    });
+    if (trainDone_) {
+      break;
+    }
+    // count the tokens up to the reported offsets, not the ones the
+    // threads have trained on since
+    std::vector<TrainState> states = trainStates_;
+    int64_t tokens = startTokenCount_;
+    for (auto it = states.cbegin(); it != states.cend(); ++it) {
+      tokens += it->tokens;
+    }
+    lastTokens = tokenCount;
+    last = now;
+    lock.unlock();
+    saveCheckpoint(states, tokens);
+    lock.lock();
+  }
+}
+
+void FastText::saveCheckpoint(const std::vector<TrainState>& states,
+                              int64_t tokens) {
+  // the matrices are written while the training threads keep updating
+  // them, so they hold some updates past the saved offsets: the snapshot
+  // is as fuzzy as the Hogwild reads themselves
+  std::string fn(args_->output + ".ckpt");
+  std::string tmp(fn + ".tmp");
+  std::ofstream ofs(tmp, std::ofstream::binary);
+  if (!ofs.is_open()) {
+    std::cerr << "Checkpoint file cannot be opened for saving!" << std::endl;
+    return;
+  }
+  signModel(ofs);
+  args_->save(ofs);
+  dict_->save(ofs);
+  input_->save(ofs);
+  output_->save(ofs);
+  ofs.write((char*) &tokens, sizeof(int64_t));
+  ofs.write((char*) &(args_->lr), sizeof(double));
+  int32_t nthreads = states.size();
+  ofs.write((char*) &nthreads, sizeof(int32_t));
+  for (auto it = states.cbegin(); it != states.cend(); ++it) {
+    int32_t size = it->rng.size();
+    ofs.write((char*) &(it->offset), sizeof(int64_t));
+    ofs.write((char*) &size, sizeof(int32_t));
+    ofs.write(it->rng.data(), size);
+  }
+  ofs.close();
+  if (ofs.fail() || rename(tmp.c_str(), fn.c_str()) != 0) {
+    std::cerr << "Checkpoint could not be written to " << fn << std::endl;
+  }
+}
+
+bool FastText::loadCheckpoint(const std::string& filename) {
+  std::ifstream ifs(filename, std::ifstream::binary);
+  if (!ifs.is_open()) {
+    std::cerr << "No checkpoint found, training from scratch." << std::endl;
+    return false;
+  }
+  if (!checkModel(ifs)) {
+    std::cerr << "Checkpoint file has wrong file format!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  args_->load(ifs);
+  dict_->load(ifs);
+  input_ = std::make_shared<Matrix>();
+  input_->load(ifs);
+  output_ = std::make_shared<Matrix>();
+  output_->load(ifs);
+
+  int64_t tokens;
+  int32_t nthreads;
+  ifs.read((char*) &tokens, sizeof(int64_t));
+  ifs.read((char*) &(args_->lr), sizeof(double));
+  ifs.read((char*) &nthreads, sizeof(int32_t));
+  trainStates_.resize(nthreads);
+  for (int32_t i = 0; i < nthreads; i++) {
+    int32_t size;
+    ifs.read((char*) &(trainStates_[i].offset), sizeof(int64_t));
+    ifs.read((char*) &size, sizeof(int32_t));
+    trainStates_[i].checkpoint = 0;
+    trainStates_[i].tokens = 0;
+    trainStates_[i].rng.resize(size);
+    ifs.read(&trainStates_[i].rng[0], size);
+  }
+  if (ifs.fail()) {
+    std::cerr << "Checkpoint file is truncated!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (nthreads != args_->thread) {
+    std::cerr << "Resuming with the " << nthreads
+              << " threads of the checkpoint." << std::endl;
+    args_->thread = nthreads;
+  }
+  tokenCount = tokens;
+  return true;
+}
+
 void FastText::trainThread(int32_t threadId) {
   std::ifstream ifs(args_->input);
-  utils::seek(ifs, threadId * utils::size(ifs) / args_->thread);
+  const TrainState& resumed = trainStates_[threadId];
+  if (resumed.offset >= 0) {
+    utils::seek(ifs, resumed.offset);
+  } else {
+    utils::seek(ifs, threadId * utils::size(ifs) / args_->thread);
+  }
 
   Model model(input_, output_, args_, threadId);
+  model.setTree(tree_);
+  if (!resumed.rng.empty()) {
+    std::istringstream rng(resumed.rng);
+    rng >> model.rng;
+  }
   if (args_->model == model_name::sup) {
     model.setTargetCounts(dict_->getCounts(entry_type::label));
   } else {
@@ -724,7 +1223,7 @@ void FastText::trainThread(int32_t threadId) {
   }
 
   const int64_t ntokens = dict_->ntokens();
-  int64_t localTokenCount = 0;
+  int64_t localTokenCount = 0, threadTokenCount = 0;
   std::vector<int32_t> line, labels;
   while (tokenCount < args_->epoch * ntokens) {
     real progress = real(tokenCount) / (args_->epoch * ntokens);
@@ -741,7 +1240,11 @@ void FastText::trainThread(int32_t threadId) {
     }
     if (localTokenCount > args_->lrUpdateRate) {
       tokenCount += localTokenCount;
+      threadTokenCount += localTokenCount;
       localTokenCount = 0;
+      if (checkpointRequest_ > trainStates_[threadId].checkpoint) {
+        reportTrainState(threadId, ifs, model, threadTokenCount);
+      }
       if (threadId == 0 && args_->verbose > 1) {
         printInfo(progress, model.getLoss());
       }
@@ -751,6 +1254,11 @@ void FastText::trainThread(int32_t threadId) {
     printInfo(1.0, model.getLoss());
     std::cerr << std::endl;
   }
+  {
+    std::lock_guard<std::mutex> lock(checkpointMutex_);
+    trainStates_[threadId].checkpoint = std::numeric_limits<int64_t>::max();
+  }
+  checkpointCv_.notify_all();
   ifs.close();
 }
 
@@ -794,6 +1302,27 @@ void FastText::loadVectors(std::string filename) {
   }
 }
 
+// Every thread starts from its share of the input
+void FastText::resetTrainStates() {
+  tokenCount = 0;
+  checkpointRequest_ = 0;
+  trainStates_.assign(args_->thread, TrainState{0, -1, 0, ""});
+}
+
+// Shared by train and quantize -retrain once the matrices are in place
+void FastText::prepareTraining() {
+  if (args_->loss == loss_name::hs) {
+    // built once here and shared by the models of all training threads
+    if (args_->model == model_name::sup) {
+      tree_ = Model::buildTree(dict_->getCounts(entry_type::label));
+    } else {
+      tree_ = Model::buildTree(dict_->getCounts(entry_type::word));
+    }
+  }
+  start = clock();
+  startTokenCount_ = tokenCount;
+}
+
 void FastText::train(std::shared_ptr<Args> args) {
   args_ = args;
   dict_ = std::make_shared<Dictionary>(args_);
@@ -807,25 +1336,34 @@ void FastText::train(std::shared_ptr<Args> args) {
     std::cerr << "Input file cannot be opened!" << std::endl;
     exit(EXIT_FAILURE);
   }
-  dict_->readFromFile(ifs);
-  ifs.close();
 
-  if (args_->pretrainedVectors.size() != 0) {
-    loadVectors(args_->pretrainedVectors);
-  } else {
-    input_ = std::make_shared<Matrix>(dict_->nwords()+args_->bucket, args_->dim);
-    input_->uniform(1.0 / args_->dim);
-  }
+  const std::string checkpoint(args_->output + ".ckpt");
+  resetTrainStates();
+  if (!args_->resume || !loadCheckpoint(checkpoint)) {
+    dict_->readFromFile(ifs);
 
-  if (args_->model == model_name::sup) {
-    output_ = std::make_shared<Matrix>(dict_->nlabels(), args_->dim);
-  } else {
-    output_ = std::make_shared<Matrix>(dict_->nwords(), args_->dim);
+    if (args_->pretrainedVectors.size() != 0) {
+      loadVectors(args_->pretrainedVectors);
+    } else {
+      input_ = std::make_shared<Matrix>(dict_->nwords()+args_->bucket, args_->dim);
+      input_->uniform(1.0 / args_->dim);
+    }
+
+    if (args_->model == model_name::sup) {
+      output_ = std::make_shared<Matrix>(dict_->nlabels(), args_->dim);
+    } else {
+      output_ = std::make_shared<Matrix>(dict_->nwords(), args_->dim);
+    }
+    output_->zero();
   }
-  output_->zero();
+  ifs.close();
 
-  start = clock();
-  tokenCount = 0;
+  prepareTraining();
+  trainDone_ = false;
+  std::thread checkpointer;
+  if (args_->checkpointTokens > 0 || args_->checkpointMinutes > 0) {
+    checkpointer = std::thread([this]() { checkpointThread(); });
+  }
   if (args_->thread > 1) {
     std::vector<std::thread> threads;
     for (int32_t i = 0; i < args_->thread; i++) {
@@ -837,9 +1375,19 @@ void FastText::train(std::shared_ptr<Args> args) {
   } else {
     trainThread(0);
   }
+  if (checkpointer.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(checkpointMutex_);
+      trainDone_ = true;
+    }
+    checkpointCv_.notify_all();
+    checkpointer.join();
+  }
   model_ = std::make_shared<Model>(input_, output_, args_, 0);
 
   saveModel();
+  // the final model supersedes any checkpoint of this run
+  remove(checkpoint.c_str());
   if (args_->model != model_name::sup && args_->model != model_name::sent2vec) {
     saveVectors();
     if (args_->saveOutput > 0) {
@@ -16,13 +16,20 @@
 #include <time.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <string>
+#include <vector>
 
 #include "args.h"
+#include "cache.h"
 #include "dictionary.h"
 #include "matrix.h"
 #include "qmatrix.h"
+#include "cmatrix.h"
 #include "model.h"
 #include "real.h"
 #include "utils.h"
@@ -30,6 +37,16 @@
 
 namespace fasttext {
 
+enum class format_name : int {text=1, f32, f16, npy};
+
+// where a training thread stood when it answered a checkpoint request
+struct TrainState {
+  int64_t checkpoint;
+  int64_t offset;
+  int64_t tokens;
+  std::string rng;
+};
+
 class FastText {
   private:
     std::shared_ptr<Args> args_;
@@ -40,25 +57,54 @@ class FastText {
 
     std::shared_ptr<QMatrix> qinput_;
     std::shared_ptr<QMatrix> qoutput_;
+
+    std::shared_ptr<CMatrix> cinput_;
+
+    std::shared_ptr<VectorCache> cache_;
     
     std::shared_ptr<Model> model_;
+    std::shared_ptr<const HuffmanTree> tree_;
     
     std::atomic<int64_t> tokenCount;
+    int64_t startTokenCount_;
     clock_t start;
+
+    std::mutex checkpointMutex_;
+    std::condition_variable checkpointCv_;
+    std::atomic<int64_t> checkpointRequest_;
+    std::vector<TrainState> trainStates_;
+    bool trainDone_;
+    void checkpointThread();
+    void reportTrainState(int32_t, std::ifstream&, const Model&, int64_t);
+    void saveCheckpoint(const std::vector<TrainState>&, int64_t);
+    bool loadCheckpoint(const std::string&);
+    void resetTrainStates();
+    void prepareTraining();
+
     void signModel(std::ostream&);
     bool checkModel(std::istream&);
 
     bool quant_;
+    bool compressed_;
+
+    void addInputRow(Vector&, int32_t) const;
 
   public:
     FastText();
 
+    static void processLines(std::istream&, int32_t,
+                             const std::function<void(int32_t,
+                                                      const std::vector<std::string>&,
+                                                      std::string&)>&,
+                             std::ostream&);
+
     void getVector(Vector&, const std::string&) const;
     void saveVectors();
     void saveOutput();
     void saveModel();
-    void loadModel(const std::string&);
-    void loadModel(std::istream&);
+    void loadModel(const std::string&, bool lazy = false);
+    void loadModel(std::istream&, const std::string& mapFilename = "");
+    int64_t pinRows(std::istream&);
     void printInfo(real, real);
 
     void supervised(Model&, real, const std::vector<int32_t>&,
@@ -68,15 +114,15 @@ class FastText {
     void skipgram(Model&, real, const std::vector<int32_t>&);
     std::vector<int32_t> selectEmbeddings(int32_t) const;
     void quantize(std::shared_ptr<Args>);
-    void test(std::istream&, int32_t);
-    void predict(std::istream&, int32_t, bool);
+    void test(std::istream&, int32_t, int32_t);
+    void predict(std::istream&, int32_t, bool, int32_t);
     void predict(std::istream&, int32_t, std::vector<std::pair<real,std::string>>&) const;
     void wordVectors();
     void sentenceVectors();
     void ngramVectors(std::string);
-    void textVectors();
+    void textVectors(int32_t, format_name);
     void printWordVectors();
-    void printSentenceVectors();
+    void printSentenceVectors(int32_t, format_name);
     void trainThread(int32_t);
     void train(std::shared_ptr<Args>);
     void precomputeWordVectors(Matrix&);
@@ -93,6 +139,12 @@ class FastText {
     void loadVectors(std::string);
     int getDimension() const;
     Vector singleSentenceVector(std::string &sentence);
+    void sentenceVector(std::istream&, Vector&, std::minstd_rand&) const;
+    void sentenceTokens(std::istream&, std::vector<int32_t>&,
+                        std::minstd_rand&) const;
+    void tokensVector(std::vector<int32_t>&, Vector&) const;
+    void setCache(size_t);
+    std::shared_ptr<const VectorCache> getCache() const;
 };
 
 }
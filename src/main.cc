@@ -10,14 +10,25 @@
 #include <iostream>
 
 #include "fasttext.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "queue.h"
+#include "redisqueue.h"
+#include "request.h"
+#include "server.h"
+#include "tokenizer.h"
 #include <cpp_redis/cpp_redis>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <sstream>
+#include <unistd.h>
 
 #define __FILENAME__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
 
-#include "../lib/json.hpp"
-
 using namespace fasttext;
 
 void printUsage() {
@@ -38,6 +49,9 @@ void printUsage() {
     << "  nnSent                  query for nearest neighbors for sentences\n"
     << "  analogies               query for analogies\n"
     << "  analogiesSent           query for analogies for Sentences\n"
+    << "  queue-mode              serve sentence vectors from a request queue\n"
+    << "  serve                   serve sentence vectors over a local socket\n"
+    << "  tokenize                tokenize raw text like tweetTokenize.py\n"
     << std::endl;  
 }
 
@@ -49,22 +63,42 @@ void printQuantizeUsage() {
 
 void printTestUsage() {
   std::cerr
-    << "usage: fasttext test <model> <test-data> [<k>]\n\n"
+    << "usage: fasttext test <model> <test-data> [<k>] [-thread <n>]\n\n"
     << "  <model>      model filename\n"
     << "  <test-data>  test data filename (if -, read from stdin)\n"
     << "  <k>          (optional; 1 by default) predict top k labels\n"
+    << "  -thread      (optional; 1 by default) number of threads\n"
     << std::endl;
 }
 
 void printPredictUsage() {
   std::cerr
-    << "usage: fasttext predict[-prob] <model> <test-data> [<k>]\n\n"
+    << "usage: fasttext predict[-prob] <model> <test-data> [<k>] [-thread <n>]\n\n"
     << "  <model>      model filename\n"
     << "  <test-data>  test data filename (if -, read from stdin)\n"
     << "  <k>          (optional; 1 by default) predict top k labels\n"
+    << "  -thread      (optional; 1 by default) number of threads\n"
     << std::endl;
 }
 
+bool parsePredictArgs(int argc, char** argv, int32_t& k, int32_t& thread) {
+  if (argc < 4) {
+    return false;
+  }
+  int ai = 4;
+  if (ai < argc && argv[ai][0] != '-') {
+    k = atoi(argv[ai++]);
+  }
+  for (; ai < argc; ai += 2) {
+    if (strcmp(argv[ai], "-thread") == 0 && ai + 1 < argc) {
+      thread = std::max(atoi(argv[ai + 1]), 1);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
 void printPrintWordVectorsUsage() {
   std::cerr
     << "usage: fasttext print-word-vectors <model>\n\n"
@@ -74,8 +108,12 @@ void printPrintWordVectorsUsage() {
 
 void printPrintSentenceVectorsUsage() {
   std::cerr
-    << "usage: fasttext print-sentence-vectors <model>\n\n"
+    << "usage: fasttext print-sentence-vectors <model> [-thread <n>] [-format <f>]\n\n"
     << "  <model>      model filename\n"
+    << "  -thread      (optional; 1 by default) number of threads\n"
+    << "  -format      (optional; text by default) output format {text, f32, f16, npy}\n"
+    << "               f32/f16 write raw little-endian rows, npy needs stdout\n"
+    << "               redirected to a file\n"
     << std::endl;
 }
 
@@ -88,6 +126,52 @@ void printRedisModeVectorsUsage() {
 }
 
 
+void printQueueModeUsage() {
+  std::cerr
+    << "usage: fasttext queue-mode <model> <transport> [<address>]\n\n"
+    << "  <model>      model filename\n"
+    << "  <transport>  where requests come from and responses go to:\n"
+    << "    redis-list <key>    BLPOP from a Redis list, like redis-mode, with\n"
+    << "                        REDIS_PREFETCH [16] of them in flight\n"
+    << "    redis-stream <key>  XREAD from a Redis stream, request in field \"payload\"\n"
+    << "    redis-group <key>   XREADGROUP from a Redis stream, acknowledged after the\n"
+    << "                        response; REDIS_GROUP [sent2vec], REDIS_CONSUMER\n"
+    << "                        [host-pid], REDIS_BATCH [64], REDIS_CLAIM_IDLE_MS [60000]\n"
+    << "    lines               stdin to stdout, one JSON object per line\n"
+    << "    unix <path>         clients of a Unix domain socket, one per line\n"
+    << "    memory              stdin read into memory, then timed per stage\n"
+    << std::endl;
+}
+
+void printServeUsage() {
+  std::cerr
+    << "usage: fasttext serve <model> [options]\n\n"
+    << "  <model>      model filename\n"
+    << "  -unix        path of a Unix domain socket to listen on\n"
+    << "  -port        TCP port to listen on\n"
+    << "  -host        (optional; 127.0.0.1 by default) address of the TCP port\n"
+    << "  -thread      (optional; 1 by default) number of worker threads\n"
+    << "  -batch       (optional; 32 by default) most requests per batch\n"
+    << "  -wait        (optional; 0 by default) microseconds a batch may wait\n"
+    << "               for more requests\n"
+    << "  -tokenize    (optional) requests are raw text to tokenize first\n\n"
+    << "Requests are a little-endian uint32 length and the tokenized text,\n"
+    << "responses a uint32 length and the vector as little-endian float32.\n"
+    << std::endl;
+}
+
+void printTokenizeUsage() {
+  std::cerr
+    << "usage: fasttext tokenize [-thread <n>] [-tweets]\n\n"
+    << "  -thread      (optional; 1 by default) number of threads\n"
+    << "  -tweets      (optional) lines are language, id, timestamp, user name\n"
+    << "               and text separated by tabs; English ones of 7 to 109\n"
+    << "               tokens are written as id, timestamp, user name and text\n\n"
+    << "Reads text from stdin and writes it tokenized, lowercased and with urls\n"
+    << "and @handles replaced by <url> and <user> to stdout, line by line.\n"
+    << std::endl;
+}
+
 void printPrintNgramsUsage() {
   std::cerr
     << "usage: fasttext print-ngrams <model> <word>\n\n"
@@ -146,42 +230,38 @@ void printAnalogiesSentUsage() {
 }
 
 void test(int argc, char** argv) {
-  if (argc < 4 || argc > 5) {
+  int32_t k = 1;
+  int32_t thread = 1;
+  if (!parsePredictArgs(argc, argv, k, thread)) {
     printTestUsage();
     exit(EXIT_FAILURE);
   }
-  int32_t k = 1;
-  if (argc >= 5) {
-    k = atoi(argv[4]);
-  }
 
   FastText fasttext;
   fasttext.loadModel(std::string(argv[2]));
 
   std::string infile(argv[3]);
   if (infile == "-") {
-    fasttext.test(std::cin, k);
+    fasttext.test(std::cin, k, thread);
   } else {
     std::ifstream ifs(infile);
     if (!ifs.is_open()) {
       std::cerr << "Test file cannot be opened!" << std::endl;
       exit(EXIT_FAILURE);
     }
-    fasttext.test(ifs, k);
+    fasttext.test(ifs, k, thread);
     ifs.close();
   }
   exit(0);
 }
 
 void predict(int argc, char** argv) {
-  if (argc < 4 || argc > 5) {
+  int32_t k = 1;
+  int32_t thread = 1;
+  if (!parsePredictArgs(argc, argv, k, thread)) {
     printPredictUsage();
     exit(EXIT_FAILURE);
   }
-  int32_t k = 1;
-  if (argc >= 5) {
-    k = atoi(argv[4]);
-  }
 
   bool print_prob = std::string(argv[1]) == "predict-prob";
   FastText fasttext;
@@ -189,14 +269,14 @@ void predict(int argc, char** argv) {
 
   std::string infile(argv[3]);
   if (infile == "-") {
-    fasttext.predict(std::cin, k, print_prob);
+    fasttext.predict(std::cin, k, print_prob, thread);
   } else {
     std::ifstream ifs(infile);
     if (!ifs.is_open()) {
       std::cerr << "Input file cannot be opened!" << std::endl;
       exit(EXIT_FAILURE);
     }
-    fasttext.predict(ifs, k, print_prob);
+    fasttext.predict(ifs, k, print_prob, thread);
     ifs.close();
   }
 
@@ -215,13 +295,37 @@ void printWordVectors(int argc, char** argv) {
 }
 
 void printSentenceVectors(int argc, char** argv) {
-  if (argc != 3) {
+  if (argc < 3) {
     printPrintSentenceVectorsUsage();
     exit(EXIT_FAILURE);
   }
+  int32_t thread = 1;
+  format_name format = format_name::text;
+  for (int ai = 3; ai < argc; ai += 2) {
+    if (strcmp(argv[ai], "-thread") == 0 && ai + 1 < argc) {
+      thread = std::max(atoi(argv[ai + 1]), 1);
+    } else if (strcmp(argv[ai], "-format") == 0 && ai + 1 < argc) {
+      std::string f(argv[ai + 1]);
+      if (f == "text") {
+        format = format_name::text;
+      } else if (f == "f32") {
+        format = format_name::f32;
+      } else if (f == "f16") {
+        format = format_name::f16;
+      } else if (f == "npy") {
+        format = format_name::npy;
+      } else {
+        printPrintSentenceVectorsUsage();
+        exit(EXIT_FAILURE);
+      }
+    } else {
+      printPrintSentenceVectorsUsage();
+      exit(EXIT_FAILURE);
+    }
+  }
   FastText fasttext;
   fasttext.loadModel(std::string(argv[2]));
-  fasttext.printSentenceVectors();
+  fasttext.printSentenceVectors(thread, format);
   exit(0);
 }
 
@@ -308,13 +412,19 @@ void train(int argc, char** argv) {
   fasttext.train(a);
 }
 
-void redisMode(int argc, char** argv) {
-  if (argc != 4) {
-    printRedisModeVectorsUsage();
-    exit(EXIT_FAILURE);
-  }
-  // Logger instance
-  cpp_redis::active_logger = std::unique_ptr<cpp_redis::logger>(new cpp_redis::logger(cpp_redis::logger::log_level::debug));
+std::string envOr(const char* name, const std::string& value) {
+  const char* env = std::getenv(name);
+  return env != NULL && *env ? std::string(env) : value;
+}
+
+void connectRedis(cpp_redis::client& client) {
+  // Logger instance, LOG_LEVEL=debug also logs every request
+  const std::string level = envOr("LOG_LEVEL", "info");
+  auto log_level = level == "debug" ? cpp_redis::logger::log_level::debug :
+                   level == "warn" ? cpp_redis::logger::log_level::warn :
+                   level == "error" ? cpp_redis::logger::log_level::error :
+                   cpp_redis::logger::log_level::info;
+  cpp_redis::active_logger = std::unique_ptr<cpp_redis::logger>(new cpp_redis::logger(log_level));
 
   const char* redis_host = std::getenv("REDIS_HOST");
   const char* redis_port = std::getenv("REDIS_PORT");
@@ -323,7 +433,6 @@ void redisMode(int argc, char** argv) {
   const std::string msg = "Trying to connect with Redis host " + std::string(redis_host) + ":" + std::string(redis_port);
   cpp_redis::active_logger->info(msg, __FILENAME__, __LINE__);
 
-  cpp_redis::client client;
   client.connect(redis_host, redis_port_int);
   client.auth(redis_pw);
 
@@ -336,88 +445,257 @@ void redisMode(int argc, char** argv) {
   } else {
     cpp_redis::active_logger->error("Could not connect to Redis.", __FILENAME__, __LINE__);
   }
+}
+
+void loadServingModel(FastText& fasttext, const std::string& filename) {
+  // Optional lazy loading: map the input matrix and fault rows in on demand
+  const char* model_mmap = std::getenv("MODEL_MMAP");
+  const char* model_hot_rows = std::getenv("MODEL_HOT_ROWS");
+  bool lazy = model_mmap != NULL && std::string(model_mmap) == "1";
 
-  // Queue Names
-  const std::vector<std::string> redis_listen_queue{std::string(argv[3])};
+  std::cerr << "Loading model..." << std::endl;
+  fasttext.loadModel(filename, lazy);
+  std::cerr << "... done" << std::endl;
+
+  // Optional cache of sentence vectors for repeated texts
+  const char* cache_bytes = std::getenv("EMBEDDING_CACHE_BYTES");
+  if (cache_bytes != NULL) {
+    fasttext.setCache(std::strtoull(cache_bytes, NULL, 10));
+  }
+
+  if (lazy && model_hot_rows != NULL) {
+    std::ifstream ifs(model_hot_rows);
+    if (!ifs.is_open()) {
+      std::cerr << "Hot rows file cannot be opened" << std::endl;
+    } else {
+      int64_t pinned = fasttext.pinRows(ifs);
+      std::cerr << "Pinned " << pinned << " rows" << std::endl;
+    }
+  }
+}
+
+// hostname-pid, unique among the workers of a consumer group
+std::string defaultConsumer() {
+  char host[256] = "sent2vec";
+  gethostname(host, sizeof(host) - 1);
+  return std::string(host) + "-" + std::to_string(getpid());
+}
+
+// METRICS_FILE is rewritten every METRICS_INTERVAL seconds, e.g. for the
+// textfile collector of the Prometheus node exporter
+void startMetrics(Metrics& metrics, const FastText& fasttext) {
+  const std::string path = envOr("METRICS_FILE", "");
+  if (path.empty()) {
+    return;
+  }
+  int32_t interval = std::atoi(envOr("METRICS_INTERVAL", "10").c_str());
+  metrics.setCache(fasttext.getCache());
+  metrics.dumpEvery(path, std::max(interval, 1));
+}
+
+void serveQueue(const std::string& model, const std::string& transport,
+                const std::string& address) {
+  const bool redis = transport.compare(0, 6, "redis-") == 0;
+  cpp_redis::client client, reader;
+  if (redis) {
+    connectRedis(client);
+  }
+  if (transport == "redis-list") {
+    connectRedis(reader);
+  }
 
   FastText fasttext;
-  cpp_redis::active_logger->info("Loading model...", __FILENAME__, __LINE__);
-  fasttext.loadModel(std::string(argv[2]));
-  cpp_redis::active_logger->info("... done", __FILENAME__, __LINE__);
-
-  while(client.is_connected()) {
-    const std::string msg = "Fetching new work from queue" + redis_listen_queue[0];
-    cpp_redis::active_logger->debug(msg, __FILENAME__, __LINE__);
-
-    // Get new text_obj
-    auto response = client.blpop(redis_listen_queue,3600);
-    client.sync_commit();
-    response.wait();
-    std::string resp_str;
-    auto reply = response.get();
-    try {
-      auto reply_arr = reply.as_array();
-      resp_str = reply_arr[1].as_string();
+  loadServingModel(fasttext, model);
+  Pipeline pipeline(fasttext);
+  Metrics metrics;
+  pipeline.setMetrics(metrics.shard());
+  startMetrics(metrics, fasttext);
+  if (envOr("ECHO_REQUESTS", "0") == "1" && transport != "lines") {
+    pipeline.setEcho(&std::cout);
+  }
+
+  std::unique_ptr<Queue> queue;
+  if (transport == "redis-list") {
+    int32_t depth = std::atoi(envOr("REDIS_PREFETCH", "16").c_str());
+    queue.reset(new RedisListQueue(reader, client, address, depth));
+  } else if (transport == "redis-stream") {
+    queue.reset(new RedisStreamQueue(client, address, 64));
+  } else if (transport == "redis-group") {
+    int32_t batch = std::atoi(envOr("REDIS_BATCH", "64").c_str());
+    int64_t minIdle = std::atoll(envOr("REDIS_CLAIM_IDLE_MS", "60000").c_str());
+    if (batch <= 0 || minIdle <= 0) {
+      std::cerr << "REDIS_BATCH and REDIS_CLAIM_IDLE_MS must be positive"
+                << std::endl;
+      exit(EXIT_FAILURE);
     }
-    catch(...) {
-      cpp_redis::active_logger->debug("New element is not of correct type.", __FILENAME__, __LINE__);
-      continue;
+    queue.reset(new RedisGroupQueue(client, address,
+                                    envOr("REDIS_GROUP", "sent2vec"),
+                                    envOr("REDIS_CONSUMER", defaultConsumer()),
+                                    batch, minIdle));
+  } else if (transport == "lines") {
+    queue.reset(new LineQueue(std::cin, std::cout));
+  } else if (transport == "unix") {
+    queue.reset(new UnixSocketQueue(address));
+  } else if (transport == "memory") {
+    // everything is read up front so that only the pipeline is timed
+    MemoryQueue* memory = new MemoryQueue(false);
+    queue.reset(memory);
+    std::string line;
+    while (std::getline(std::cin, line)) {
+      memory->put(line);
     }
+    memory->close();
+  } else {
+    printQueueModeUsage();
+    exit(EXIT_FAILURE);
+  }
 
-    // parse into JSON
-    nlohmann::json text_obj;
-    try {
-      text_obj = nlohmann::json::parse(resp_str);
-    } catch(nlohmann::detail::type_error) {
-      cpp_redis::active_logger->error("Could not parse string to JSON", __FILENAME__, __LINE__);
-      continue;
+  auto start = std::chrono::steady_clock::now();
+  pipeline.serve(*queue);
+  double seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  pipeline.printStats(transport == "memory" ? std::cout : std::cerr, seconds);
+}
+
+void queueMode(int argc, char** argv) {
+  if (argc < 4 || argc > 5) {
+    printQueueModeUsage();
+    exit(EXIT_FAILURE);
+  }
+  std::string transport(argv[3]);
+  bool named = transport == "redis-list" || transport == "redis-stream" ||
+               transport == "redis-group" || transport == "unix";
+  if (named != (argc == 5)) {
+    printQueueModeUsage();
+    exit(EXIT_FAILURE);
+  }
+  serveQueue(argv[2], transport, named ? argv[4] : "");
+}
+
+void serve(int argc, char** argv) {
+  if (argc < 3) {
+    printServeUsage();
+    exit(EXIT_FAILURE);
+  }
+  std::string unixPath, host = "127.0.0.1";
+  int32_t port = 0, thread = 1, batch = 32;
+  int64_t wait = 0;
+  bool tokenize = false;
+  for (int ai = 3; ai < argc; ai++) {
+    if (strcmp(argv[ai], "-tokenize") == 0) {
+      tokenize = true;
+    } else if (ai + 1 >= argc) {
+      printServeUsage();
+      exit(EXIT_FAILURE);
+    } else if (strcmp(argv[ai], "-unix") == 0) {
+      unixPath = argv[++ai];
+    } else if (strcmp(argv[ai], "-port") == 0) {
+      port = atoi(argv[++ai]);
+    } else if (strcmp(argv[ai], "-host") == 0) {
+      host = argv[++ai];
+    } else if (strcmp(argv[ai], "-thread") == 0) {
+      thread = atoi(argv[++ai]);
+    } else if (strcmp(argv[ai], "-batch") == 0) {
+      batch = atoi(argv[++ai]);
+    } else if (strcmp(argv[ai], "-wait") == 0) {
+      wait = atoll(argv[++ai]);
+    } else {
+      printServeUsage();
+      exit(EXIT_FAILURE);
     }
+  }
+  if (unixPath.empty() && port <= 0) {
+    printServeUsage();
+    exit(EXIT_FAILURE);
+  }
 
-    // Compute sentence vector
-    std::cout << text_obj << std::endl;
-    if (text_obj["text_tokenized"] == NULL || text_obj["text_tokenized"] == "") {
-      cpp_redis::active_logger->error("text_tokenized field is empty", __FILENAME__, __LINE__);
-      continue;
+  FastText fasttext;
+  loadServingModel(fasttext, argv[2]);
+  Metrics metrics;
+  EmbeddingServer server(fasttext, thread, batch, wait);
+  server.setMetrics(&metrics);
+  server.setTokenize(tokenize);
+  server.listen(unixPath, host, port);
+  startMetrics(metrics, fasttext);
+  std::cerr << "Listening" << (unixPath.empty() ? "" : " on " + unixPath)
+            << (port > 0 ? " on " + host + ":" + std::to_string(port) : "")
+            << std::endl;
+  server.run();
+}
+
+void tokenize(int argc, char** argv) {
+  int32_t thread = 1;
+  bool tweets = false;
+  for (int ai = 2; ai < argc; ai++) {
+    if (strcmp(argv[ai], "-thread") == 0 && ai + 1 < argc) {
+      thread = std::max(atoi(argv[++ai]), 1);
+    } else if (strcmp(argv[ai], "-tweets") == 0) {
+      tweets = true;
+    } else {
+      printTokenizeUsage();
+      exit(EXIT_FAILURE);
     }
-    std::string text = text_obj["text_tokenized"];
-    Vector result = fasttext.singleSentenceVector(text);
-    std::vector<float> embedding_vector = {};
-
-    // Read out result into vector
-    for (int64_t j = 0; j < result.m_; j++) {
-      if (std::isnan(result.data_[j])) {
-        embedding_vector = {};
-        break;
-      } else {
-        embedding_vector.push_back(static_cast<float>(result.data_[j]));
+  }
+  std::vector<Tokenizer> tokenizers(thread);
+  std::atomic<int64_t> unparsed(0);
+  FastText::processLines(std::cin, thread,
+                         [&](int32_t threadId, const std::vector<std::string>& lines,
+                             std::string& out) {
+    Tokenizer& tokenizer = tokenizers[threadId];
+    std::string text, tokens;
+    std::vector<std::string> fields;
+    for (auto it = lines.cbegin(); it != lines.cend(); ++it) {
+      // lines come with their newline
+      text.assign(*it, 0, it->size() - 1);
+      if (!tweets) {
+        tokenizer.preprocess(text, tokens);
+        out.append(tokens);
+        out.push_back('\n');
+        continue;
       }
+      // language, id, timestamp, user name and text, as tweetTokenize.py
+      // expects them
+      const size_t begin = text.find_first_not_of(" \t\r\f\v");
+      const size_t end = text.find_last_not_of(" \t\r\f\v");
+      fields.clear();
+      for (size_t p = begin; begin != std::string::npos && p <= end;) {
+        size_t tab = std::min(text.find('\t', p), end + 1);
+        fields.push_back(text.substr(p, tab - p));
+        p = tab + 1;
+      }
+      if (fields.size() != 5) {
+        unparsed++;
+        continue;
+      }
+      if (fields[0] != "en") {
+        continue;
+      }
+      int32_t ntokens = tokenizer.preprocess(fields[4], tokens);
+      if (ntokens <= 6 || ntokens >= 110) {
+        continue;
+      }
+      out.append(fields[1] + "\t" + fields[2] + "\t" + fields[3] + "\t");
+      out.append(tokens);
+      out.push_back('\n');
     }
-    text_obj["sentence_vector"] = embedding_vector;
-
-    // Push to result queue
-    std::vector<std::string> text_obj_dump = {};
-    try {
-      text_obj_dump = {text_obj.dump()};
-    } catch(nlohmann::detail::type_error) {
-      cpp_redis::active_logger->error("Could not convert JSON to string", __FILENAME__, __LINE__);
-      continue;
-    }
+  }, std::cout);
+  if (unparsed > 0) {
+    std::cerr << "Could not parse " << unparsed << " lines." << std::endl;
+  }
+}
 
-    // Push to result queue
-    if (text_obj["result_queue"] == NULL || text_obj["result_queue"] == "") {
-      cpp_redis::active_logger->error("No result queue given", __FILENAME__, __LINE__);
-      continue;
-    }
-    client.rpush(text_obj["result_queue"], text_obj_dump);
-    if (text_obj.count("mode") > 0 && text_obj["mode"] == "single_request") {
-      cpp_redis::active_logger->debug("Setting expiration to key", __FILENAME__, __LINE__);
-      client.expire(text_obj["result_queue"], 10);
-    }
+void redisMode(int argc, char** argv) {
+  if (argc != 4) {
+    printRedisModeVectorsUsage();
+    exit(EXIT_FAILURE);
   }
+  serveQueue(argv[2], "redis-list", argv[3]);
 }
 
 
 int main(int argc, char** argv) {
+  // give std::cin a buffer that Dictionary::readWord can scan in place
+  std::ios_base::sync_with_stdio(false);
   if (argc < 2) {
     printUsage();
     exit(EXIT_FAILURE);
@@ -448,6 +726,12 @@ int main(int argc, char** argv) {
     predict(argc, argv);
   } else if (command == "redis-mode") {
     redisMode(argc, argv);
+  } else if (command == "queue-mode") {
+    queueMode(argc, argv);
+  } else if (command == "serve") {
+    serve(argc, argv);
+  } else if (command == "tokenize") {
+    tokenize(argc, argv);
   } else {
     printUsage();
     exit(EXIT_FAILURE);
@@ -10,7 +10,11 @@
 #include "matrix.h"
 
 #include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
+#include <iostream>
 #include <random>
 
 #include "utils.h"
@@ -18,25 +22,25 @@
 
 namespace fasttext {
 
-Matrix::Matrix() {
+Matrix::Matrix() : map_(nullptr), mapSize_(0), rows_(nullptr) {
   m_ = 0;
   n_ = 0;
   data_ = nullptr;
 }
 
-Matrix::Matrix(int64_t m, int64_t n) {
+Matrix::Matrix(int64_t m, int64_t n) : map_(nullptr), mapSize_(0) {
   m_ = m;
   n_ = n;
   data_ = new real[m * n];
+  rows_ = (const char*) data_;
 }
 
-Matrix::Matrix(const Matrix& other) {
+Matrix::Matrix(const Matrix& other) : map_(nullptr), mapSize_(0) {
   m_ = other.m_;
   n_ = other.n_;
   data_ = new real[m_ * n_];
-  for (int64_t i = 0; i < (m_ * n_); i++) {
-    data_[i] = other.data_[i];
-  }
+  rows_ = (const char*) data_;
+  std::memcpy(data_, other.rows_, m_ * n_ * sizeof(real));
 }
 
 Matrix& Matrix::operator=(const Matrix& other) {
@@ -44,11 +48,18 @@ Matrix& Matrix::operator=(const Matrix& other) {
   m_ = temp.m_;
   n_ = temp.n_;
   std::swap(data_, temp.data_);
+  std::swap(map_, temp.map_);
+  std::swap(mapSize_, temp.mapSize_);
+  std::swap(rows_, temp.rows_);
   return *this;
 }
 
 Matrix::~Matrix() {
-  delete[] data_;
+  if (map_) {
+    munmap(map_, mapSize_);
+  } else {
+    delete[] data_;
+  }
 }
 
 void Matrix::zero() {
@@ -130,15 +141,85 @@ void Matrix::l2NormRow(Vector& norms) const {
 void Matrix::save(std::ostream& out) {
   out.write((char*) &m_, sizeof(int64_t));
   out.write((char*) &n_, sizeof(int64_t));
-  out.write((char*) data_, m_ * n_ * sizeof(real));
+  out.write(rows_, m_ * n_ * sizeof(real));
 }
 
 void Matrix::load(std::istream& in) {
   in.read((char*) &m_, sizeof(int64_t));
   in.read((char*) &n_, sizeof(int64_t));
-  delete[] data_;
-  data_ = new real[m_ * n_];
+  Matrix temp(m_, n_);
+  std::swap(data_, temp.data_);
+  std::swap(map_, temp.map_);
+  std::swap(mapSize_, temp.mapSize_);
+  std::swap(rows_, temp.rows_);
   in.read((char*) data_, m_ * n_ * sizeof(real));
 }
 
+// Maps the rows from the file backing the stream instead of reading them.
+// Pages are faulted in on first access, so only the rows that are actually
+// used become resident. The mapping is read-only, so processes serving the
+// same model share its pages, and the matrix must not be modified. Rows
+// follow a variable-length dictionary, so they need not be aligned for real
+// and are only read through at().
+void Matrix::loadMapped(std::istream& in, const std::string& filename) {
+  int64_t m, n;
+  in.read((char*) &m, sizeof(int64_t));
+  in.read((char*) &n, sizeof(int64_t));
+  const int64_t offset = in.tellg();
+  const size_t bytes = m * n * sizeof(real);
+  const int64_t page = sysconf(_SC_PAGESIZE);
+  const int64_t aligned = offset - offset % page;
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Model file cannot be opened for mapping!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  const size_t size = bytes + (offset - aligned);
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, aligned);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    std::cerr << "Model file cannot be mapped!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  madvise(addr, size, MADV_RANDOM);
+
+  Matrix temp;
+  std::swap(data_, temp.data_);
+  std::swap(map_, temp.map_);
+  std::swap(mapSize_, temp.mapSize_);
+  std::swap(rows_, temp.rows_);
+  m_ = m;
+  n_ = n;
+  map_ = addr;
+  mapSize_ = size;
+  rows_ = (const char*) addr + (offset - aligned);
+  in.seekg(bytes, std::ios_base::cur);
+}
+
+// Faults in the given rows and locks them in memory when the process is
+// allowed to. Returns the number of rows that were locked.
+int64_t Matrix::pinRows(const std::vector<int32_t>& rows) {
+  if (!map_) {
+    return 0;
+  }
+  const int64_t page = sysconf(_SC_PAGESIZE);
+  int64_t locked = 0;
+  for (auto it = rows.cbegin(); it != rows.cend(); ++it) {
+    assert(*it >= 0);
+    assert(*it < m_);
+    uintptr_t begin = (uintptr_t) (rows_ + *it * n_ * sizeof(real));
+    uintptr_t end = begin + n_ * sizeof(real);
+    begin -= begin % page;
+    madvise((void*) begin, end - begin, MADV_WILLNEED);
+    if (mlock((void*) begin, end - begin) == 0) {
+      locked++;
+    } else {
+      volatile real touch = at(*it, 0);
+      (void) touch;
+    }
+  }
+  return locked;
+}
+
 }
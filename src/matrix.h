@@ -11,8 +11,11 @@
 #define FASTTEXT_MATRIX_H
 
 #include <cstdint>
+#include <cstring>
 #include <istream>
 #include <ostream>
+#include <string>
+#include <vector>
 
 #include "real.h"
 
@@ -21,6 +24,12 @@ namespace fasttext {
 class Vector;
 
 class Matrix {
+  private:
+    void* map_;
+    size_t mapSize_;
+    // Row storage as bytes: data_ when the matrix owns its rows, or the
+    // mapped file, where rows need not be aligned for real.
+    const char* rows_;
 
   public:
     real* data_;
@@ -33,7 +42,11 @@ class Matrix {
     Matrix& operator=(const Matrix&);
     ~Matrix();
 
-    inline const real& at(int64_t i, int64_t j) const {return data_[i * n_ + j];};
+    inline real at(int64_t i, int64_t j) const {
+      real v;
+      std::memcpy(&v, rows_ + (i * n_ + j) * sizeof(real), sizeof(real));
+      return v;
+    };
     inline real& at(int64_t i, int64_t j) {return data_[i * n_ + j];};
 
 
@@ -50,6 +63,8 @@ class Matrix {
 
     void save(std::ostream&);
     void load(std::istream&);
+    void loadMapped(std::istream&, const std::string&);
+    int64_t pinRows(const std::vector<int32_t>&);
 };
 
 }
@@ -0,0 +1,193 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "metrics.h"
+
+#include <stdio.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+namespace fasttext {
+
+namespace {
+
+const char* ERROR_NAMES[] = {"parse", "empty_text", "encode", "too_large"};
+const char* STAGE_NAMES[] = {"decode", "tokenize", "embed", "encode"};
+
+// Sum of the same histogram over all shards
+struct Totals {
+  int64_t base;
+  int64_t buckets[Histogram::NBUCKETS + 1];
+  int64_t sum;
+
+  explicit Totals(int64_t b) : base(b), sum(0) {
+    for (int32_t i = 0; i <= Histogram::NBUCKETS; i++) {
+      buckets[i] = 0;
+    }
+  }
+
+  void add(const Histogram& h) {
+    for (int32_t i = 0; i <= Histogram::NBUCKETS; i++) {
+      buckets[i] += h.bucket(i);
+    }
+    sum += h.sum();
+  }
+};
+
+// labels are either empty or end with a comma; scale converts to the unit
+void writeHistogram(std::ostream& out, const std::string& name,
+                    const std::string& labels, const Totals& totals,
+                    double scale) {
+  int64_t count = 0;
+  for (int32_t i = 0; i <= Histogram::NBUCKETS; i++) {
+    count += totals.buckets[i];
+    out << name << "_bucket{" << labels << "le=\"";
+    if (i < Histogram::NBUCKETS) {
+      out << (totals.base << i) * scale;
+    } else {
+      out << "+Inf";
+    }
+    out << "\"} " << count << "\n";
+  }
+  std::string suffix = labels.empty() ? "" :
+    "{" + labels.substr(0, labels.size() - 1) + "}";
+  out << name << "_sum" << suffix << " " << totals.sum * scale << "\n";
+  out << name << "_count" << suffix << " " << count << "\n";
+}
+
+}
+
+void Histogram::observe(int64_t value) {
+  int32_t i = 0;
+  int64_t bound = base_;
+  while (i < NBUCKETS && value > bound) {
+    bound <<= 1;
+    i++;
+  }
+  buckets_[i].add(1);
+  sum_.add(value);
+}
+
+MetricsShard::MetricsShard() : batchSize(1) {}
+
+Metrics::Metrics() : stop_(false) {}
+
+Metrics::~Metrics() {
+  if (dumper_.joinable()) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    dumper_.join();
+  }
+}
+
+MetricsShard* Metrics::shard() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  shards_.emplace_back(new MetricsShard());
+  return shards_.back().get();
+}
+
+void Metrics::setCache(std::shared_ptr<const VectorCache> cache) {
+  cache_ = cache;
+}
+
+void Metrics::render(std::ostream& out) {
+  std::vector<const MetricsShard*> shards;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto it = shards_.cbegin(); it != shards_.cend(); ++it) {
+      shards.push_back(it->get());
+    }
+  }
+  int64_t requests = 0;
+  int64_t errors[MetricsShard::NERRORS] = {0};
+  Totals queueWait(1000), batchSize(1);
+  std::vector<Totals> stages(MetricsShard::NSTAGES, Totals(1000));
+  for (auto it = shards.cbegin(); it != shards.cend(); ++it) {
+    const MetricsShard& shard = **it;
+    requests += shard.requests.get();
+    for (int32_t i = 0; i < MetricsShard::NERRORS; i++) {
+      errors[i] += shard.errors[i].get();
+    }
+    queueWait.add(shard.queueWait);
+    batchSize.add(shard.batchSize);
+    for (int32_t i = 0; i < MetricsShard::NSTAGES; i++) {
+      stages[i].add(shard.stages[i]);
+    }
+  }
+
+  out << "# HELP sent2vec_requests_total Requests received.\n"
+      << "# TYPE sent2vec_requests_total counter\n"
+      << "sent2vec_requests_total " << requests << "\n";
+  out << "# HELP sent2vec_errors_total Requests that got no response.\n"
+      << "# TYPE sent2vec_errors_total counter\n";
+  for (int32_t i = 0; i < MetricsShard::NERRORS; i++) {
+    out << "sent2vec_errors_total{type=\"" << ERROR_NAMES[i] << "\"} "
+        << errors[i] << "\n";
+  }
+  out << "# HELP sent2vec_queue_wait_seconds Time a worker waited for a "
+      << "request (queue-mode) or a request waited for a worker (serve).\n"
+      << "# TYPE sent2vec_queue_wait_seconds histogram\n";
+  writeHistogram(out, "sent2vec_queue_wait_seconds", "", queueWait, 1e-9);
+  out << "# HELP sent2vec_stage_seconds Time spent per request in each "
+      << "stage.\n"
+      << "# TYPE sent2vec_stage_seconds histogram\n";
+  for (int32_t i = 0; i < MetricsShard::NSTAGES; i++) {
+    writeHistogram(out, "sent2vec_stage_seconds",
+                   std::string("stage=\"") + STAGE_NAMES[i] + "\",",
+                   stages[i], 1e-9);
+  }
+  out << "# HELP sent2vec_batch_size Requests handled per batch.\n"
+      << "# TYPE sent2vec_batch_size histogram\n";
+  writeHistogram(out, "sent2vec_batch_size", "", batchSize, 1);
+  if (cache_) {
+    out << "# HELP sent2vec_cache_hits_total Sentence vectors served from "
+        << "the cache.\n"
+        << "# TYPE sent2vec_cache_hits_total counter\n"
+        << "sent2vec_cache_hits_total " << cache_->hits() << "\n"
+        << "# HELP sent2vec_cache_misses_total Sentence vectors computed.\n"
+        << "# TYPE sent2vec_cache_misses_total counter\n"
+        << "sent2vec_cache_misses_total " << cache_->misses() << "\n";
+  }
+}
+
+void Metrics::dump() {
+  const std::string tmp = path_ + ".tmp";
+  {
+    std::ofstream ofs(tmp);
+    if (!ofs.is_open()) {
+      std::cerr << "Metrics file cannot be opened for saving!" << std::endl;
+      return;
+    }
+    render(ofs);
+  }
+  if (rename(tmp.c_str(), path_.c_str()) != 0) {
+    std::cerr << "Metrics file cannot be replaced!" << std::endl;
+  }
+}
+
+void Metrics::dumpEvery(const std::string& path, int32_t seconds) {
+  path_ = path;
+  dump();
+  dumper_ = std::thread([this, seconds]() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+      cv_.wait_for(lock, std::chrono::seconds(seconds));
+      lock.unlock();
+      dump();
+      lock.lock();
+    }
+  });
+}
+
+}
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_METRICS_H
+#define FASTTEXT_METRICS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache.h"
+
+namespace fasttext {
+
+enum class request_error : int {parse = 0, empty_text, encode, too_large};
+
+enum class stage : int {decode = 0, tokenize, embed, encode};
+
+// Counter written by a single thread. Relaxed atomics keep the increment a
+// plain add while another thread may read it at any time.
+class Counter {
+  private:
+    std::atomic<int64_t> value_;
+
+  public:
+    Counter() : value_(0) {}
+
+    void add(int64_t n) {
+      value_.store(value_.load(std::memory_order_relaxed) + n,
+                   std::memory_order_relaxed);
+    }
+
+    int64_t get() const {
+      return value_.load(std::memory_order_relaxed);
+    }
+};
+
+// Histogram written by a single thread, with buckets for values up to
+// base, 2 * base, 4 * base, ... and one for everything above. The default
+// base suits timings in nanoseconds.
+class Histogram {
+  public:
+    static const int32_t NBUCKETS = 24;
+
+  private:
+    int64_t base_;
+    Counter buckets_[NBUCKETS + 1];
+    Counter sum_;
+
+  public:
+    explicit Histogram(int64_t base = 1000) : base_(base) {}
+
+    void observe(int64_t);
+
+    int64_t base() const {
+      return base_;
+    }
+
+    int64_t bucket(int32_t i) const {
+      return buckets_[i].get();
+    }
+
+    int64_t sum() const {
+      return sum_.get();
+    }
+};
+
+// The metrics of one serving thread. Times are in nanoseconds.
+struct MetricsShard {
+  static const int32_t NERRORS = 4;
+  static const int32_t NSTAGES = 4;
+
+  Counter requests;
+  Counter errors[NERRORS];
+  Histogram queueWait;
+  Histogram stages[NSTAGES];
+  Histogram batchSize;
+
+  MetricsShard();
+
+  void error(request_error type) {
+    errors[static_cast<int>(type)].add(1);
+  }
+
+  void time(stage s, int64_t ns) {
+    stages[static_cast<int>(s)].observe(ns);
+  }
+};
+
+// Hands out one shard per thread and sums them up in the Prometheus text
+// format when asked, optionally rewriting a file every few seconds.
+class Metrics {
+  private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<MetricsShard>> shards_;
+    std::shared_ptr<const VectorCache> cache_;
+
+    std::string path_;
+    std::thread dumper_;
+    std::condition_variable cv_;
+    bool stop_;
+
+    void dump();
+
+  public:
+    Metrics();
+    ~Metrics();
+
+    MetricsShard* shard();
+    void setCache(std::shared_ptr<const VectorCache>);
+    void render(std::ostream&);
+    void dumpEvery(const std::string&, int32_t);
+};
+
+}
+
+#endif
@@ -12,6 +12,9 @@
 #include <iostream>
 #include <assert.h>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <tuple>
 
 namespace fasttext {
 
@@ -48,6 +51,10 @@ void Model::setQuantizePointer(std::shared_ptr<QMatrix> qwi,
   }
 }
 
+void Model::setCompressedPointer(std::shared_ptr<CMatrix> cwi) {
+  cwi_ = cwi;
+}
+
 real Model::binaryLogistic(int32_t target, bool label, real lr) {
   real score = sigmoid(wo_->dotRow(hidden_, target));
   real alpha = lr * (real(label) - score);
@@ -76,20 +83,24 @@ real Model::negativeSampling(int32_t target, real lr) {
 real Model::hierarchicalSoftmax(int32_t target, real lr) {
   real loss = 0.0;
   grad_.zero();
-  const std::vector<bool>& binaryCode = codes[target];
-  const std::vector<int32_t>& pathToRoot = paths[target];
-  for (int32_t i = 0; i < pathToRoot.size(); i++) {
-    loss += binaryLogistic(pathToRoot[i], binaryCode[i], lr);
+  const HuffmanTree& tree = *tree_;
+  const int64_t end = tree.pathOffsets[target + 1];
+  for (int64_t i = tree.pathOffsets[target]; i < end; i++) {
+    loss += binaryLogistic(tree.pathNodes[i], tree.pathCodes[i], lr);
   }
   return loss;
 }
 
-void Model::computeOutputSoftmax(Vector& hidden, Vector& output) const {
+void Model::computeOutput(Vector& hidden, Vector& output) const {
   if (quant_ && args_->qout) {
     output.mul(*qwo_, hidden);
   } else {
     output.mul(*wo_, hidden);
   }
+}
+
+void Model::computeOutputSoftmax(Vector& hidden, Vector& output) const {
+  computeOutput(hidden, output);
   real max = output[0], z = 0.0;
   for (int32_t i = 0; i < osz_; i++) {
     max = std::max(output[i], max);
@@ -125,6 +136,8 @@ void Model::computeHidden(const std::vector<int32_t>& input, Vector& hidden) con
   for (auto it = input.cbegin(); it != input.cend(); ++it) {
     if(quant_) {
       hidden.addRow(*qwi_, *it);
+    } else if (cwi_) {
+      hidden.addRow(*cwi_, *it);
     } else {
       hidden.addRow(*wi_, *it);
     }
@@ -151,25 +164,97 @@ void Model::predict(const std::vector<int32_t>& input, int32_t k,
   std::sort_heap(heap.begin(), heap.end(), comparePairs);
 }
 
+void Model::predict(const std::vector<std::vector<int32_t>>& inputs, int32_t k,
+                    std::vector<std::vector<std::pair<real, int32_t>>>& heaps,
+                    std::vector<std::shared_ptr<Vector>>& hiddens,
+                    Vector& output) const {
+  assert(k > 0);
+  assert(hiddens.size() >= inputs.size());
+  heaps.resize(inputs.size());
+  std::vector<int32_t> batch;
+  for (int32_t i = 0; i < inputs.size(); i++) {
+    heaps[i].clear();
+    if (inputs[i].empty()) {
+      continue;
+    }
+    heaps[i].reserve(k + 1);
+    computeHidden(inputs[i], *hiddens[i]);
+    if (args_->loss == loss_name::hs) {
+      batch.push_back(i);
+    } else {
+      findKBest(k, heaps[i], *hiddens[i], output);
+    }
+  }
+  if (!batch.empty()) {
+    dfs(k, batch, heaps, hiddens);
+  }
+  for (auto it = heaps.begin(); it != heaps.end(); ++it) {
+    std::sort_heap(it->begin(), it->end(), comparePairs);
+  }
+}
+
 void Model::predict(const std::vector<int32_t>& input, int32_t k,
                     std::vector<std::pair<real, int32_t>>& heap) {
   predict(input, k, heap, hidden_, output_);
 }
 
+inline real Model::expNonPositive(real x) {
+  // exp(x) = 2^n * 2^f with n integer and |f| <= 0.5; 2^f is a degree 6
+  // polynomial (relative error around 1e-7) and 2^n is written straight
+  // into the exponent bits, flushing to zero below 2^-126. Only integer
+  // selects are used so that the callers' loops vectorize. t is clamped
+  // first so that converting it is defined for -inf and NaN, and NaN is
+  // passed through at the end.
+  real t = x * 1.44269504f;
+  t = t > -127.0f ? t : -127.0f;
+  int32_t n = int32_t(t - 0.5f);
+  real f = t - real(n);
+  real p = 1.535336188e-4f;
+  p = p * f + 1.339887440e-3f;
+  p = p * f + 9.618437357e-3f;
+  p = p * f + 5.550332471e-2f;
+  p = p * f + 2.402264791e-1f;
+  p = p * f + 6.931472028e-1f;
+  p = p * f + 1.0f;
+  int32_t bits = n < -126 ? 0 : (n + 127) << 23;
+  real scale;
+  std::memcpy(&scale, &bits, sizeof(scale));
+  return x == x ? p * scale : x;
+}
+
 void Model::findKBest(int32_t k, std::vector<std::pair<real, int32_t>>& heap,
                       Vector& hidden, Vector& output) const {
-  computeOutputSoftmax(hidden, output);
+  // softmax is monotonic, so the k best labels are selected on the raw
+  // logits and only the winners are turned into log-probabilities.
+  computeOutput(hidden, output);
+  real* logits = output.data_;
   for (int32_t i = 0; i < osz_; i++) {
-    if (heap.size() == k && log(output[i]) < heap.front().first) {
+    if (heap.size() == k && logits[i] <= heap.front().first) {
       continue;
     }
-    heap.push_back(std::make_pair(log(output[i]), i));
+    heap.push_back(std::make_pair(logits[i], i));
     std::push_heap(heap.begin(), heap.end(), comparePairs);
     if (heap.size() > k) {
       std::pop_heap(heap.begin(), heap.end(), comparePairs);
       heap.pop_back();
     }
   }
+  real max = heap.front().first;
+  for (auto it = heap.cbegin(); it != heap.cend(); ++it) {
+    max = std::max(max, it->first);
+  }
+  for (int32_t i = 0; i < osz_; i++) {
+    logits[i] = expNonPositive(logits[i] - max);
+  }
+  real z = 0.0;
+  for (int32_t i = 0; i < osz_; i++) {
+    z += logits[i];
+  }
+  // subtracting the same constant keeps the heap ordering intact
+  const real logZ = max + std::log(z);
+  for (auto it = heap.begin(); it != heap.end(); ++it) {
+    it->first -= logZ;
+  }
 }
 
 void Model::dfs(int32_t k, int32_t node, real score,
@@ -179,6 +264,8 @@ void Model::dfs(int32_t k, int32_t node, real score,
     return;
   }
 
+  const std::vector<Node>& tree = tree_->nodes;
+
   if (tree[node].left == -1 && tree[node].right == -1) {
     heap.push_back(std::make_pair(score, node));
     std::push_heap(heap.begin(), heap.end(), comparePairs);
@@ -200,6 +287,72 @@ void Model::dfs(int32_t k, int32_t node, real score,
   dfs(k, tree[node].right, score + log(f), heap, hidden);
 }
 
+void Model::dfs(int32_t k, const std::vector<int32_t>& batch,
+                std::vector<std::vector<std::pair<real, int32_t>>>& heaps,
+                const std::vector<std::shared_ptr<Vector>>& hiddens) const {
+  // Same traversal as the recursive dfs, but every node is expanded once
+  // for all the examples that still reach it: the row of wo_ is read once
+  // per node instead of once per example. Pending nodes own a slice of
+  // (example, score) pairs in pool; children are pushed above their parent
+  // so both frames and pool behave as stacks.
+  const std::vector<Node>& tree = tree_->nodes;
+  std::vector<std::pair<int32_t, real>> pool;
+  std::vector<std::tuple<int32_t, size_t, size_t>> frames;
+  for (auto it = batch.cbegin(); it != batch.cend(); ++it) {
+    pool.push_back(std::make_pair(*it, 0.0));
+  }
+  frames.push_back(std::make_tuple(2 * osz_ - 2, 0, pool.size()));
+  while (!frames.empty()) {
+    int32_t node;
+    size_t begin, end;
+    std::tie(node, begin, end) = frames.back();
+    frames.pop_back();
+    pool.resize(end);
+
+    size_t live = begin;
+    for (size_t i = begin; i < end; i++) {
+      const auto& heap = heaps[pool[i].first];
+      if (heap.size() == k && pool[i].second < heap.front().first) {
+        continue;
+      }
+      pool[live++] = pool[i];
+    }
+    if (live == begin) {
+      continue;
+    }
+
+    if (tree[node].left == -1 && tree[node].right == -1) {
+      for (size_t i = begin; i < live; i++) {
+        auto& heap = heaps[pool[i].first];
+        heap.push_back(std::make_pair(pool[i].second, node));
+        std::push_heap(heap.begin(), heap.end(), comparePairs);
+        if (heap.size() > k) {
+          std::pop_heap(heap.begin(), heap.end(), comparePairs);
+          heap.pop_back();
+        }
+      }
+      continue;
+    }
+
+    size_t n = live - begin;
+    pool.resize(live + n);
+    for (size_t i = begin; i < live; i++) {
+      const Vector& hidden = *hiddens[pool[i].first];
+      real f;
+      if (quant_ && args_->qout) {
+        f = sigmoid(qwo_->dotRow(hidden, node - osz_));
+      } else {
+        f = sigmoid(wo_->dotRow(hidden, node - osz_));
+      }
+      pool[i + n].first = pool[i].first;
+      pool[i + n].second = pool[i].second + log(1.0 - f);
+      pool[i].second += log(f);
+    }
+    frames.push_back(std::make_tuple(tree[node].right, begin, live));
+    frames.push_back(std::make_tuple(tree[node].left, live, live + n));
+  }
+}
+
 void Model::update(const std::vector<int32_t>& input, int32_t target, real lr) {
   assert(target >= 0);
   assert(target < osz_);
@@ -227,11 +380,19 @@ void Model::setTargetCounts(const std::vector<int64_t>& counts) {
   if (args_->loss == loss_name::ns) {
     initTableNegatives(counts);
   }
-  if (args_->loss == loss_name::hs) {
-    buildTree(counts);
+  if (args_->loss == loss_name::hs && !tree_) {
+    tree_ = buildTree(counts);
   }
 }
 
+void Model::setTree(std::shared_ptr<const HuffmanTree> tree) {
+  tree_ = tree;
+}
+
+std::shared_ptr<const HuffmanTree> Model::getTree() const {
+  return tree_;
+}
+
 void Model::initTableNegatives(const std::vector<int64_t>& counts) {
   real z = 0.0;
   for (size_t i = 0; i < counts.size(); i++) {
@@ -255,21 +416,24 @@ int32_t Model::getNegative(int32_t target) {
   return negative;
 }
 
-void Model::buildTree(const std::vector<int64_t>& counts) {
-  tree.resize(2 * osz_ - 1);
-  for (int32_t i = 0; i < 2 * osz_ - 1; i++) {
+std::shared_ptr<HuffmanTree> Model::buildTree(const std::vector<int64_t>& counts) {
+  const int32_t osz = counts.size();
+  std::shared_ptr<HuffmanTree> huffman = std::make_shared<HuffmanTree>();
+  std::vector<Node>& tree = huffman->nodes;
+  tree.resize(2 * osz - 1);
+  for (int32_t i = 0; i < 2 * osz - 1; i++) {
     tree[i].parent = -1;
     tree[i].left = -1;
     tree[i].right = -1;
     tree[i].count = 1e15;
     tree[i].binary = false;
   }
-  for (int32_t i = 0; i < osz_; i++) {
+  for (int32_t i = 0; i < osz; i++) {
     tree[i].count = counts[i];
   }
-  int32_t leaf = osz_ - 1;
-  int32_t node = osz_;
-  for (int32_t i = osz_; i < 2 * osz_ - 1; i++) {
+  int32_t leaf = osz - 1;
+  int32_t node = osz;
+  for (int32_t i = osz; i < 2 * osz - 1; i++) {
     int32_t mini[2];
     for (int32_t j = 0; j < 2; j++) {
       if (leaf >= 0 && tree[leaf].count < tree[node].count) {
@@ -285,18 +449,17 @@ void Model::buildTree(const std::vector<int64_t>& counts) {
     tree[mini[1]].parent = i;
     tree[mini[1]].binary = true;
   }
-  for (int32_t i = 0; i < osz_; i++) {
-    std::vector<int32_t> path;
-    std::vector<bool> code;
+  huffman->pathOffsets.push_back(0);
+  for (int32_t i = 0; i < osz; i++) {
     int32_t j = i;
     while (tree[j].parent != -1) {
-      path.push_back(tree[j].parent - osz_);
-      code.push_back(tree[j].binary);
+      huffman->pathNodes.push_back(tree[j].parent - osz);
+      huffman->pathCodes.push_back(tree[j].binary);
       j = tree[j].parent;
     }
-    paths.push_back(path);
-    codes.push_back(code);
+    huffman->pathOffsets.push_back(huffman->pathNodes.size());
   }
+  return huffman;
 }
 
 real Model::getLoss() const {
@@ -19,6 +19,7 @@
 #include "matrix.h"
 #include "vector.h"
 #include "qmatrix.h"
+#include "cmatrix.h"
 #include "real.h"
 
 #define SIGMOID_TABLE_SIZE 512
@@ -35,12 +36,23 @@ struct Node {
   bool binary;
 };
 
+// Huffman tree used by the hierarchical softmax. The path from output i to
+// the root is pathNodes[pathOffsets[i] .. pathOffsets[i + 1]) with the
+// matching branch taken in pathCodes. Built once and shared read-only.
+struct HuffmanTree {
+  std::vector<Node> nodes;
+  std::vector<int64_t> pathOffsets;
+  std::vector<int32_t> pathNodes;
+  std::vector<uint8_t> pathCodes;
+};
+
 class Model {
   private:
     std::shared_ptr<Matrix> wi_;
     std::shared_ptr<Matrix> wo_;
     std::shared_ptr<QMatrix> qwi_;
     std::shared_ptr<QMatrix> qwo_;
+    std::shared_ptr<CMatrix> cwi_;
     std::shared_ptr<Args> args_;
     Vector hidden_;
     Vector output_;
@@ -56,9 +68,7 @@ class Model {
     std::vector<int32_t> negatives;
     size_t negpos;
     // used for hierarchical softmax:
-    std::vector< std::vector<int32_t> > paths;
-    std::vector< std::vector<bool> > codes;
-    std::vector<Node> tree;
+    std::shared_ptr<const HuffmanTree> tree_;
 
     static bool comparePairs(const std::pair<real, int32_t>&,
                              const std::pair<real, int32_t>&);
@@ -84,26 +94,37 @@ class Model {
                  Vector&, Vector&) const;
     void predict(const std::vector<int32_t>&, int32_t,
                  std::vector<std::pair<real, int32_t>>&);
+    void predict(const std::vector<std::vector<int32_t>>&, int32_t,
+                 std::vector<std::vector<std::pair<real, int32_t>>>&,
+                 std::vector<std::shared_ptr<Vector>>&, Vector&) const;
     void dfs(int32_t, int32_t, real,
              std::vector<std::pair<real, int32_t>>&,
              Vector&) const;
+    void dfs(int32_t, const std::vector<int32_t>&,
+             std::vector<std::vector<std::pair<real, int32_t>>>&,
+             const std::vector<std::shared_ptr<Vector>>&) const;
     void findKBest(int32_t, std::vector<std::pair<real, int32_t>>&,
                    Vector&, Vector&) const;
     void update(const std::vector<int32_t>&, int32_t, real);
     void computeHidden(const std::vector<int32_t>&, Vector&) const;
+    void computeOutput(Vector&, Vector&) const;
     void computeOutputSoftmax(Vector&, Vector&) const;
     void computeOutputSoftmax();
 
     void setTargetCounts(const std::vector<int64_t>&);
     void initTableNegatives(const std::vector<int64_t>&);
-    void buildTree(const std::vector<int64_t>&);
+    static std::shared_ptr<HuffmanTree> buildTree(const std::vector<int64_t>&);
+    void setTree(std::shared_ptr<const HuffmanTree>);
+    std::shared_ptr<const HuffmanTree> getTree() const;
     real getLoss() const;
     real sigmoid(real) const;
     real log(real) const;
+    static real expNonPositive(real);
 
     std::minstd_rand rng;
     bool quant_;
     void setQuantizePointer(std::shared_ptr<QMatrix>, std::shared_ptr<QMatrix>, bool);
+    void setCompressedPointer(std::shared_ptr<CMatrix>);
 };
 
 }
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+namespace fasttext {
+
+namespace {
+
+typedef std::chrono::steady_clock clock;
+
+int64_t elapsed(clock::time_point& since) {
+  clock::time_point now = clock::now();
+  int64_t ns =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(now - since).count();
+  since = now;
+  return ns;
+}
+
+}
+
+Pipeline::Pipeline(const FastText& fasttext)
+  : fasttext_(fasttext), rng_(0), vec_(fasttext.getDimension()),
+    metrics_(&own_), echo_(nullptr) {}
+
+bool Pipeline::process(const std::string& payload, Request& request,
+                       std::string& response, std::string& error) {
+  metrics_->requests.add(1);
+  clock::time_point t = clock::now();
+  if (!parseRequest(payload, request)) {
+    metrics_->error(request_error::parse);
+    error = "Could not parse string to JSON";
+    return false;
+  }
+  metrics_->time(stage::decode, elapsed(t));
+  if (echo_) {
+    *echo_ << payload << std::endl;
+  }
+
+  t = clock::now();
+  if (request.text.empty() && !request.raw.empty()) {
+    tokenizer_.preprocess(request.raw, request.text);
+  }
+  if (request.text.empty()) {
+    metrics_->error(request_error::empty_text);
+    error = "text and text_tokenized fields are empty";
+    return false;
+  }
+  std::istringstream iss(request.text);
+  fasttext_.sentenceTokens(iss, line_, rng_);
+  metrics_->time(stage::tokenize, elapsed(t));
+  fasttext_.tokensVector(line_, vec_);
+  metrics_->time(stage::embed, elapsed(t));
+
+  try {
+    response = encodeResponse(payload, request, vec_);
+  } catch (const std::exception&) {
+    metrics_->error(request_error::encode);
+    error = "Could not convert JSON to string";
+    return false;
+  }
+  metrics_->time(stage::encode, elapsed(t));
+  return true;
+}
+
+int64_t Pipeline::serve(Queue& queue) {
+  Message message;
+  Request request;
+  std::string response, error;
+  auto cache = fasttext_.getCache();
+  int64_t processed = 0;
+  clock::time_point t = clock::now();
+  while (queue.pop(message)) {
+    metrics_->queueWait.observe(elapsed(t));
+    if (process(message.payload, request, response, error)) {
+      queue.push(message, request, response);
+      processed++;
+    } else {
+      queue.drop(message, error);
+      std::cerr << error << std::endl;
+    }
+    if (cache && metrics_->requests.get() % 10000 == 0) {
+      std::cerr << "Cache hits: " << cache->hits()
+                << ", misses: " << cache->misses() << std::endl;
+    }
+    t = clock::now();
+  }
+  queue.flush();
+  return processed;
+}
+
+void Pipeline::setEcho(std::ostream* echo) {
+  echo_ = echo;
+}
+
+void Pipeline::setMetrics(MetricsShard* metrics) {
+  metrics_ = metrics;
+}
+
+void Pipeline::printStats(std::ostream& out, double seconds) const {
+  const int64_t requests = metrics_->requests.get();
+  int64_t errors = 0;
+  for (int32_t i = 0; i < MetricsShard::NERRORS; i++) {
+    errors += metrics_->errors[i].get();
+  }
+  const int64_t n = std::max(requests, int64_t(1));
+  const Histogram* stages = metrics_->stages;
+  out << "{\"requests\": " << requests
+      << ", \"errors\": " << errors
+      << ", \"seconds\": " << seconds
+      << ", \"requests_per_s\": " << (seconds > 0 ? requests / seconds : 0)
+      << ", \"ns_per_request\": {\"decode\": " << stages[0].sum() / n
+      << ", \"tokenize\": " << stages[1].sum() / n
+      << ", \"embed\": " << stages[2].sum() / n
+      << ", \"encode\": " << stages[3].sum() / n << "}}" << std::endl;
+}
+
+}
@@ -0,0 +1,53 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_PIPELINE_H
+#define FASTTEXT_PIPELINE_H
+
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fasttext.h"
+#include "metrics.h"
+#include "queue.h"
+#include "request.h"
+#include "tokenizer.h"
+#include "vector.h"
+
+namespace fasttext {
+
+// Turns request payloads into responses: decode the JSON, tokenize the
+// text, embed it and encode the response. Knows nothing of the transport.
+class Pipeline {
+  private:
+    const FastText& fasttext_;
+    std::minstd_rand rng_;
+    std::vector<int32_t> line_;
+    Tokenizer tokenizer_;
+    Vector vec_;
+    MetricsShard own_;
+    MetricsShard* metrics_;
+    std::ostream* echo_;
+
+  public:
+    explicit Pipeline(const FastText&);
+
+    bool process(const std::string&, Request&, std::string&, std::string&);
+    int64_t serve(Queue&);
+    void setEcho(std::ostream*);
+    void setMetrics(MetricsShard*);
+    void printStats(std::ostream&, double) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "queue.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <vector>
+
+namespace fasttext {
+
+LineQueue::LineQueue(std::istream& in, std::ostream& out)
+  : in_(in), out_(out) {}
+
+bool LineQueue::pop(Message& message) {
+  // hand out what is buffered first, flush before waiting for more input
+  if (in_.rdbuf()->in_avail() <= 0) {
+    out_.flush();
+  }
+  return static_cast<bool>(std::getline(in_, message.payload));
+}
+
+void LineQueue::push(const Message&, const Request&,
+                     const std::string& response) {
+  out_ << response << '\n';
+}
+
+void LineQueue::drop(const Message&, const std::string& error) {
+  out_ << encodeError(error) << '\n';
+}
+
+void LineQueue::flush() {
+  out_.flush();
+}
+
+UnixSocketQueue::UnixSocketQueue(const std::string& path)
+  : path_(path), nextId_(0) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Socket path is too long: " << path << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  listenFd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path.c_str());
+  if (listenFd_ < 0 ||
+      bind(listenFd_, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+      listen(listenFd_, SOMAXCONN) != 0) {
+    std::cerr << "Cannot listen on " << path << ": " << strerror(errno)
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+UnixSocketQueue::~UnixSocketQueue() {
+  for (auto it = connections_.cbegin(); it != connections_.cend(); ++it) {
+    ::close(it->second.fd);
+  }
+  ::close(listenFd_);
+  unlink(path_.c_str());
+}
+
+void UnixSocketQueue::accept() {
+  int fd = ::accept(listenFd_, nullptr, nullptr);
+  if (fd >= 0) {
+    Connection& connection = connections_[nextId_++];
+    connection.fd = fd;
+  }
+}
+
+bool UnixSocketQueue::receive(int64_t id, Connection& connection) {
+  char buffer[65536];
+  ssize_t n = read(connection.fd, buffer, sizeof(buffer));
+  if (n < 0 && errno == EINTR) {
+    return true;
+  }
+  if (n <= 0) {
+    return false;
+  }
+  connection.buffer.append(buffer, n);
+  size_t start = 0;
+  size_t end;
+  while ((end = connection.buffer.find('\n', start)) != std::string::npos) {
+    ready_.emplace_back();
+    ready_.back().payload.assign(connection.buffer, start, end - start);
+    ready_.back().id = std::to_string(id);
+    start = end + 1;
+  }
+  connection.buffer.erase(0, start);
+  return true;
+}
+
+void UnixSocketQueue::close(int64_t id) {
+  auto it = connections_.find(id);
+  if (it != connections_.end()) {
+    ::close(it->second.fd);
+    connections_.erase(it);
+  }
+}
+
+bool UnixSocketQueue::pop(Message& message) {
+  std::vector<struct pollfd> fds;
+  std::vector<int64_t> ids;
+  while (ready_.empty()) {
+    fds.clear();
+    ids.clear();
+    fds.push_back({listenFd_, POLLIN, 0});
+    for (auto it = connections_.cbegin(); it != connections_.cend(); ++it) {
+      fds.push_back({it->second.fd, POLLIN, 0});
+      ids.push_back(it->first);
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "poll failed: " << strerror(errno) << std::endl;
+      return false;
+    }
+    for (size_t i = 1; i < fds.size(); i++) {
+      if (fds[i].revents != 0 && !receive(ids[i - 1], connections_[ids[i - 1]])) {
+        close(ids[i - 1]);
+      }
+    }
+    if (fds[0].revents & POLLIN) {
+      accept();
+    }
+  }
+  message = std::move(ready_.front());
+  ready_.pop_front();
+  return true;
+}
+
+void UnixSocketQueue::push(const Message& message, const Request&,
+                           const std::string& response) {
+  write(message, response);
+}
+
+void UnixSocketQueue::drop(const Message& message, const std::string& error) {
+  write(message, encodeError(error));
+}
+
+void UnixSocketQueue::write(const Message& message,
+                            const std::string& response) {
+  auto it = connections_.find(std::stoll(message.id));
+  if (it == connections_.end()) {
+    // the client went away before its answer was ready
+    return;
+  }
+  std::string out = response + '\n';
+  size_t written = 0;
+  while (written < out.size()) {
+    ssize_t n = send(it->second.fd, out.data() + written, out.size() - written,
+                     MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      close(it->first);
+      return;
+    }
+    written += n;
+  }
+}
+
+MemoryQueue::MemoryQueue(bool keep)
+  : closed_(false), keep_(keep), nresponses_(0) {}
+
+void MemoryQueue::put(const std::string& payload) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  requests_.push_back(payload);
+  cv_.notify_one();
+}
+
+void MemoryQueue::close() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  closed_ = true;
+  cv_.notify_all();
+}
+
+bool MemoryQueue::take(std::string& response) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (responses_.empty()) {
+    return false;
+  }
+  response = std::move(responses_.front());
+  responses_.pop_front();
+  return true;
+}
+
+int64_t MemoryQueue::responses() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return nresponses_;
+}
+
+bool MemoryQueue::pop(Message& message) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this]() { return closed_ || !requests_.empty(); });
+  if (requests_.empty()) {
+    return false;
+  }
+  message.payload = std::move(requests_.front());
+  requests_.pop_front();
+  return true;
+}
+
+void MemoryQueue::push(const Message&, const Request&,
+                       const std::string& response) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  nresponses_++;
+  if (keep_) {
+    responses_.push_back(response);
+  }
+}
+
+}
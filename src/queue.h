@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_QUEUE_H
+#define FASTTEXT_QUEUE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "request.h"
+
+namespace fasttext {
+
+// A request payload together with whatever the transport needs to answer
+// it, e.g. the connection it came from.
+struct Message {
+  std::string payload;
+  std::string id;
+};
+
+// Where requests come from and where their responses go. pop blocks until
+// a request arrives and returns false once the queue is closed. Every
+// message is then either answered with push or given up on with drop, which
+// gets the reason. Responses may be buffered until the next pop or flush.
+class Queue {
+  public:
+    virtual ~Queue() {}
+    virtual bool pop(Message&) = 0;
+    virtual void push(const Message&, const Request&, const std::string&) = 0;
+    virtual void drop(const Message&, const std::string&) {}
+    virtual void flush() {}
+};
+
+// One request per line on an input stream, one response per line on an
+// output stream, in the same order. A request that is dropped gets an
+// {"error": ...} line.
+class LineQueue : public Queue {
+  private:
+    std::istream& in_;
+    std::ostream& out_;
+
+  public:
+    LineQueue(std::istream&, std::ostream&);
+
+    bool pop(Message&) override;
+    void push(const Message&, const Request&, const std::string&) override;
+    void drop(const Message&, const std::string&) override;
+    void flush() override;
+};
+
+// Listens on a Unix domain socket. Clients send one request per line and
+// get the responses back on the same connection, in order, with an
+// {"error": ...} line for a request that is dropped.
+class UnixSocketQueue : public Queue {
+  private:
+    struct Connection {
+      int fd;
+      std::string buffer;
+    };
+
+    std::string path_;
+    int listenFd_;
+    int64_t nextId_;
+    std::map<int64_t, Connection> connections_;
+    std::deque<Message> ready_;
+
+    void accept();
+    bool receive(int64_t, Connection&);
+    void close(int64_t);
+    void write(const Message&, const std::string&);
+
+  public:
+    explicit UnixSocketQueue(const std::string&);
+    ~UnixSocketQueue();
+
+    bool pop(Message&) override;
+    void push(const Message&, const Request&, const std::string&) override;
+    void drop(const Message&, const std::string&) override;
+};
+
+// Thread-safe queue held in memory, to drive the pipeline without any
+// transport cost. Responses are kept for take unless told otherwise.
+class MemoryQueue : public Queue {
+  private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::string> requests_;
+    std::deque<std::string> responses_;
+    bool closed_;
+    bool keep_;
+    int64_t nresponses_;
+
+  public:
+    explicit MemoryQueue(bool keep = true);
+
+    void put(const std::string&);
+    void close();
+    bool take(std::string&);
+    int64_t responses();
+
+    bool pop(Message&) override;
+    void push(const Message&, const Request&, const std::string&) override;
+};
+
+}
+
+#endif
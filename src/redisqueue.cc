@@ -0,0 +1,301 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "redisqueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define __FILENAME__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
+
+namespace fasttext {
+
+namespace {
+
+void logFailure(cpp_redis::reply& reply) {
+  if (reply.is_error()) {
+    cpp_redis::active_logger->error("Redis command failed: " + reply.error(), __FILENAME__, __LINE__);
+  }
+}
+
+// Takes the entries of an XREAD, XREADGROUP or XAUTOCLAIM reply,
+// [[id, [field, value, ...]], ...], with the request in the "payload" field.
+// The ids of entries without one are added to invalid.
+void readEntries(const cpp_redis::reply& reply, std::deque<Message>& ready,
+                 std::vector<std::string>& invalid) {
+  if (!reply.is_array()) {
+    return;
+  }
+  const auto& entries = reply.as_array();
+  for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+    if (!it->is_array() || it->as_array().empty()) {
+      continue;
+    }
+    const auto& entry = it->as_array();
+    bool found = false;
+    if (entry.size() == 2 && entry[1].is_array()) {
+      const auto& fields = entry[1].as_array();
+      for (size_t i = 0; i + 1 < fields.size() && !found; i += 2) {
+        if (fields[i].as_string() == "payload") {
+          ready.emplace_back();
+          ready.back().payload = fields[i + 1].as_string();
+          ready.back().id = entry[0].as_string();
+          found = true;
+        }
+      }
+    }
+    if (!found) {
+      invalid.push_back(entry[0].as_string());
+    }
+  }
+}
+
+// The entries of the only stream of an XREAD or XREADGROUP reply
+const cpp_redis::reply* streamEntries(const cpp_redis::reply& reply) {
+  if (!reply.is_array() || reply.as_array().empty() ||
+      !reply.as_array()[0].is_array() ||
+      reply.as_array()[0].as_array().size() != 2) {
+    return nullptr;
+  }
+  return &reply.as_array()[0].as_array()[1];
+}
+
+}
+
+RedisQueue::RedisQueue(cpp_redis::client& client) : client_(client) {}
+
+void RedisQueue::push(const Message&, const Request& request,
+                      const std::string& response) {
+  if (request.resultQueue.empty()) {
+    cpp_redis::active_logger->error("No result queue given", __FILENAME__, __LINE__);
+    return;
+  }
+  client_.rpush(request.resultQueue, {response}, logFailure);
+  if (request.mode == "single_request") {
+    cpp_redis::active_logger->debug("Setting expiration to key", __FILENAME__, __LINE__);
+    client_.expire(request.resultQueue, 10, logFailure);
+  }
+}
+
+void RedisQueue::flush() {
+  client_.sync_commit();
+}
+
+RedisListQueue::RedisListQueue(cpp_redis::client& reader,
+                               cpp_redis::client& writer,
+                               const std::string& key, int32_t depth)
+  : RedisQueue(writer), reader_(reader), keys_{key},
+    fetching_("Fetching new work from queue" + key),
+    depth_(std::max(depth, 1)), unsent_(0), inflight_(0) {}
+
+void RedisListQueue::fetched(cpp_redis::reply& reply) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  inflight_--;
+  if (reply.is_array() && reply.as_array().size() == 2 &&
+      reply.as_array()[1].is_string()) {
+    ready_.emplace_back();
+    ready_.back().payload = reply.as_array()[1].as_string();
+  } else if (!reply.is_null()) {
+    cpp_redis::active_logger->debug("New element is not of correct type.", __FILENAME__, __LINE__);
+  }
+  cv_.notify_one();
+}
+
+bool RedisListQueue::pop(Message& message) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (ready_.empty() || unsent_ >= depth_) {
+      client_.commit();
+      unsent_ = 0;
+    }
+    // top up the BLPOPs in flight; replies arrive in the network thread
+    const int32_t missing = depth_ - inflight_;
+    if (missing > 0) {
+      inflight_ = depth_;
+      lock.unlock();
+      cpp_redis::active_logger->debug(fetching_, __FILENAME__, __LINE__);
+      for (int32_t i = 0; i < missing; i++) {
+        reader_.blpop(keys_, 3600, [this](cpp_redis::reply& reply) {
+          fetched(reply);
+        });
+      }
+      reader_.commit();
+      lock.lock();
+    }
+    if (!ready_.empty()) {
+      message = std::move(ready_.front());
+      ready_.pop_front();
+      return true;
+    }
+    if (!reader_.is_connected()) {
+      return false;
+    }
+    cv_.wait_for(lock, std::chrono::seconds(1), [this]() {
+      return !ready_.empty() || inflight_ < depth_;
+    });
+  }
+}
+
+void RedisListQueue::push(const Message& message, const Request& request,
+                          const std::string& response) {
+  RedisQueue::push(message, request, response);
+  unsent_++;
+}
+
+RedisStreamQueue::RedisStreamQueue(cpp_redis::client& client,
+                                   const std::string& key, int32_t count)
+  : RedisQueue(client), key_(key), count_(std::to_string(count)),
+    lastId_("$") {}
+
+bool RedisStreamQueue::pop(Message& message) {
+  while (ready_.empty()) {
+    if (!client_.is_connected()) {
+      return false;
+    }
+    auto response = client_.send({"XREAD", "COUNT", count_, "BLOCK", "3600000",
+                                  "STREAMS", key_, lastId_});
+    client_.sync_commit();
+    response.wait();
+    auto reply = response.get();
+    if (reply.is_null()) {
+      continue;
+    }
+    const cpp_redis::reply* entries = streamEntries(reply);
+    if (entries == nullptr) {
+      cpp_redis::active_logger->error("Unexpected XREAD reply", __FILENAME__, __LINE__);
+      continue;
+    }
+    std::vector<std::string> invalid;
+    readEntries(*entries, ready_, invalid);
+    if (!invalid.empty()) {
+      cpp_redis::active_logger->error("Stream entry without payload", __FILENAME__, __LINE__);
+    }
+    const auto& list = entries->as_array();
+    if (!list.empty() && list.back().is_array() && !list.back().as_array().empty()) {
+      lastId_ = list.back().as_array()[0].as_string();
+    }
+  }
+  message = std::move(ready_.front());
+  ready_.pop_front();
+  return true;
+}
+
+RedisGroupQueue::RedisGroupQueue(cpp_redis::client& client,
+                                 const std::string& key,
+                                 const std::string& group,
+                                 const std::string& consumer, int32_t count,
+                                 int64_t minIdle)
+  : RedisQueue(client), key_(key), group_(group), consumer_(consumer),
+    count_(std::to_string(count)), minIdle_(minIdle), claimCursor_("0-0") {
+  auto response = client_.send({"XGROUP", "CREATE", key_, group_, "$",
+                                "MKSTREAM"});
+  client_.sync_commit();
+  auto reply = response.get();
+  if (reply.is_error() && reply.error().find("BUSYGROUP") == std::string::npos) {
+    cpp_redis::active_logger->error("Could not create consumer group: " + reply.error(), __FILENAME__, __LINE__);
+  }
+}
+
+void RedisGroupQueue::ack() {
+  if (acks_.empty()) {
+    return;
+  }
+  std::vector<std::string> command = {"XACK", key_, group_};
+  command.insert(command.end(), acks_.begin(), acks_.end());
+  acks_.clear();
+  client_.send(command, [](cpp_redis::reply& reply) {
+    if (reply.is_error()) {
+      cpp_redis::active_logger->error("XACK failed: " + reply.error(), __FILENAME__, __LINE__);
+    }
+  });
+}
+
+void RedisGroupQueue::claim() {
+  ack();
+  auto response = client_.send({"XAUTOCLAIM", key_, group_, consumer_,
+                                std::to_string(minIdle_), claimCursor_,
+                                "COUNT", count_});
+  client_.sync_commit();
+  auto reply = response.get();
+  if (!reply.is_array() || reply.as_array().size() < 2) {
+    // e.g. a server older than 6.2: only read new entries from now on
+    cpp_redis::active_logger->error("XAUTOCLAIM failed", __FILENAME__, __LINE__);
+    claimCursor_ = "0-0";
+    lastClaim_ = std::chrono::steady_clock::now();
+    return;
+  }
+  // [cursor, entries] and, since Redis 7, the ids of deleted entries
+  claimCursor_ = reply.as_array()[0].as_string();
+  readEntries(reply.as_array()[1], ready_, acks_);
+  if (!ready_.empty()) {
+    cpp_redis::active_logger->info("Claimed " + std::to_string(ready_.size()) + " pending entries", __FILENAME__, __LINE__);
+  }
+  if (claimCursor_ == "0-0") {
+    lastClaim_ = std::chrono::steady_clock::now();
+  }
+}
+
+void RedisGroupQueue::read() {
+  ack();
+  // wake up at least every minIdle to look for entries to claim
+  auto response = client_.send({"XREADGROUP", "GROUP", group_, consumer_,
+                                "COUNT", count_,
+                                "BLOCK", std::to_string(minIdle_),
+                                "STREAMS", key_, ">"});
+  client_.sync_commit();
+  auto reply = response.get();
+  if (reply.is_null()) {
+    return;
+  }
+  const cpp_redis::reply* entries = streamEntries(reply);
+  if (entries == nullptr) {
+    cpp_redis::active_logger->error("Unexpected XREADGROUP reply", __FILENAME__, __LINE__);
+    return;
+  }
+  size_t invalid = acks_.size();
+  readEntries(*entries, ready_, acks_);
+  if (acks_.size() > invalid) {
+    cpp_redis::active_logger->error("Stream entry without payload", __FILENAME__, __LINE__);
+  }
+}
+
+bool RedisGroupQueue::pop(Message& message) {
+  const std::chrono::milliseconds interval(minIdle_);
+  while (ready_.empty()) {
+    if (!client_.is_connected()) {
+      return false;
+    }
+    if (claimCursor_ != "0-0" ||
+        std::chrono::steady_clock::now() - lastClaim_ >= interval) {
+      claim();
+    } else {
+      read();
+    }
+  }
+  message = std::move(ready_.front());
+  ready_.pop_front();
+  return true;
+}
+
+void RedisGroupQueue::push(const Message& message, const Request& request,
+                           const std::string& response) {
+  RedisQueue::push(message, request, response);
+  acks_.push_back(message.id);
+}
+
+void RedisGroupQueue::drop(const Message& message, const std::string&) {
+  acks_.push_back(message.id);
+}
+
+void RedisGroupQueue::flush() {
+  ack();
+  client_.sync_commit();
+}
+
+}
@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_REDISQUEUE_H
+#define FASTTEXT_REDISQUEUE_H
+
+#include <cpp_redis/cpp_redis>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "queue.h"
+
+namespace fasttext {
+
+// Responses are RPUSHed to the list named by the request's result_queue,
+// which expires after 10s for single_request clients. They are sent along
+// with the next read. Replies are not waited for, only failures logged.
+class RedisQueue : public Queue {
+  protected:
+    cpp_redis::client& client_;
+
+  public:
+    explicit RedisQueue(cpp_redis::client&);
+
+    void push(const Message&, const Request&, const std::string&) override;
+    void flush() override;
+};
+
+// Requests are taken from a list with BLPOP, keeping depth of them in
+// flight on their own connection so that the next requests arrive while
+// the current ones are embedded. Responses go over the other connection,
+// where no blocked BLPOP holds them up, and are sent whenever the queue
+// runs dry or depth of them have piled up.
+class RedisListQueue : public RedisQueue {
+  private:
+    cpp_redis::client& reader_;
+    std::vector<std::string> keys_;
+    std::string fetching_;
+    int32_t depth_;
+    int32_t unsent_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Message> ready_;
+    int32_t inflight_;
+
+    void fetched(cpp_redis::reply&);
+
+  public:
+    RedisListQueue(cpp_redis::client&, cpp_redis::client&, const std::string&,
+                   int32_t);
+
+    bool pop(Message&) override;
+    void push(const Message&, const Request&, const std::string&) override;
+};
+
+// Requests are read from a stream with XREAD, up to count entries at a
+// time. The payload is the "payload" field of each entry.
+class RedisStreamQueue : public RedisQueue {
+  private:
+    std::string key_;
+    std::string count_;
+    std::string lastId_;
+    std::deque<Message> ready_;
+
+  public:
+    RedisStreamQueue(cpp_redis::client&, const std::string&, int32_t);
+
+    bool pop(Message&) override;
+};
+
+// Requests are read from a stream as a member of a consumer group, up to
+// count entries per XREADGROUP. Entries are acknowledged with one XACK per
+// batch, sent after their responses, so a worker that dies in between
+// leaves them pending. Entries pending for longer than minIdle on any
+// consumer are taken over with XAUTOCLAIM and processed again.
+class RedisGroupQueue : public RedisQueue {
+  private:
+    std::string key_;
+    std::string group_;
+    std::string consumer_;
+    std::string count_;
+    int64_t minIdle_;
+    std::chrono::steady_clock::time_point lastClaim_;
+    std::string claimCursor_;
+    std::vector<std::string> acks_;
+    std::deque<Message> ready_;
+
+    void claim();
+    void read();
+    void ack();
+
+  public:
+    RedisGroupQueue(cpp_redis::client&, const std::string&, const std::string&,
+                    const std::string&, int32_t, int64_t);
+
+    bool pop(Message&) override;
+    void push(const Message&, const Request&, const std::string&) override;
+    void drop(const Message&, const std::string&) override;
+    void flush() override;
+};
+
+}
+
+#endif
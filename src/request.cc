@@ -0,0 +1,410 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "request.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "utils.h"
+#include "../lib/json.hpp"
+
+namespace fasttext {
+
+namespace {
+
+const std::string VECTOR_FIELD = "sentence_vector";
+const std::string VECTOR_B64_FIELD = "sentence_vector_b64";
+
+// Minimal scanner over a JSON object. It decodes the top-level string
+// fields it is asked for and skips every other value without building it,
+// but checks it, since the payload is copied into the response as is.
+class Scanner {
+  private:
+    static const int32_t MAX_DEPTH = 256;
+
+    const std::string& s_;
+    size_t pos_;
+
+    bool literal(const char* word) {
+      const size_t n = strlen(word);
+      if (s_.compare(pos_, n, word) != 0) {
+        return false;
+      }
+      pos_ += n;
+      return true;
+    }
+
+    bool digits() {
+      const size_t start = pos_;
+      while (pos_ < s_.size() && s_[pos_] >= '0' && s_[pos_] <= '9') {
+        pos_++;
+      }
+      return pos_ > start;
+    }
+
+    // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+    bool number() {
+      if (pos_ < s_.size() && s_[pos_] == '-') {
+        pos_++;
+      }
+      if (pos_ < s_.size() && s_[pos_] == '0') {
+        pos_++;
+      } else if (!digits()) {
+        return false;
+      }
+      if (pos_ < s_.size() && s_[pos_] == '.') {
+        pos_++;
+        if (!digits()) {
+          return false;
+        }
+      }
+      if (pos_ < s_.size() && (s_[pos_] == 'e' || s_[pos_] == 'E')) {
+        pos_++;
+        if (pos_ < s_.size() && (s_[pos_] == '+' || s_[pos_] == '-')) {
+          pos_++;
+        }
+        if (!digits()) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+  public:
+    explicit Scanner(const std::string& s) : s_(s), pos_(0) {}
+
+    size_t pos() const {
+      return pos_;
+    }
+
+    void skipSpace() {
+      while (pos_ < s_.size() && (s_[pos_] == ' ' || s_[pos_] == '\t' ||
+                                  s_[pos_] == '\n' || s_[pos_] == '\r')) {
+        pos_++;
+      }
+    }
+
+    bool consume(char c) {
+      skipSpace();
+      if (pos_ < s_.size() && s_[pos_] == c) {
+        pos_++;
+        return true;
+      }
+      return false;
+    }
+
+    bool peek(char c) {
+      skipSpace();
+      return pos_ < s_.size() && s_[pos_] == c;
+    }
+
+    static void appendUtf8(std::string& out, uint32_t cp) {
+      if (cp < 0x80) {
+        out.push_back(char(cp));
+      } else if (cp < 0x800) {
+        out.push_back(char(0xc0 | (cp >> 6)));
+        out.push_back(char(0x80 | (cp & 0x3f)));
+      } else if (cp < 0x10000) {
+        out.push_back(char(0xe0 | (cp >> 12)));
+        out.push_back(char(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back(char(0x80 | (cp & 0x3f)));
+      } else {
+        out.push_back(char(0xf0 | (cp >> 18)));
+        out.push_back(char(0x80 | ((cp >> 12) & 0x3f)));
+        out.push_back(char(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back(char(0x80 | (cp & 0x3f)));
+      }
+    }
+
+    bool hex4(uint32_t& cp) {
+      if (pos_ + 4 > s_.size()) {
+        return false;
+      }
+      cp = 0;
+      for (int i = 0; i < 4; i++) {
+        char c = s_[pos_++];
+        cp <<= 4;
+        if (c >= '0' && c <= '9') {
+          cp |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+          cp |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+          cp |= c - 'A' + 10;
+        } else {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // Reads a string; decodes it into out unless out is null.
+    bool string(std::string* out) {
+      if (!consume('"')) {
+        return false;
+      }
+      while (pos_ < s_.size()) {
+        size_t start = pos_;
+        while (pos_ < s_.size() && s_[pos_] != '"' && s_[pos_] != '\\') {
+          if (uint8_t(s_[pos_]) < 0x20) {
+            return false;
+          }
+          pos_++;
+        }
+        if (out) {
+          out->append(s_, start, pos_ - start);
+        }
+        if (pos_ >= s_.size()) {
+          return false;
+        }
+        if (s_[pos_++] == '"') {
+          return true;
+        }
+        if (pos_ >= s_.size()) {
+          return false;
+        }
+        char c = s_[pos_++];
+        uint32_t cp = 0;
+        switch (c) {
+          case '"': cp = '"'; break;
+          case '\\': cp = '\\'; break;
+          case '/': cp = '/'; break;
+          case 'b': cp = '\b'; break;
+          case 'f': cp = '\f'; break;
+          case 'n': cp = '\n'; break;
+          case 'r': cp = '\r'; break;
+          case 't': cp = '\t'; break;
+          case 'u':
+            if (!hex4(cp)) {
+              return false;
+            }
+            if (cp >= 0xd800 && cp < 0xdc00) {
+              uint32_t low;
+              if (pos_ + 2 > s_.size() || s_[pos_] != '\\' ||
+                  s_[pos_ + 1] != 'u') {
+                return false;
+              }
+              pos_ += 2;
+              if (!hex4(low) || low < 0xdc00 || low >= 0xe000) {
+                return false;
+              }
+              cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            }
+            break;
+          default:
+            return false;
+        }
+        if (out) {
+          appendUtf8(*out, cp);
+        }
+      }
+      return false;
+    }
+
+    // Skips any value. Values nested deeper than MAX_DEPTH are refused and
+    // left to the JSON library.
+    bool skipValue(int32_t depth = 0) {
+      skipSpace();
+      if (pos_ >= s_.size()) {
+        return false;
+      }
+      const char c = s_[pos_];
+      if (c == '"') {
+        return string(nullptr);
+      }
+      if (c == '{' || c == '[') {
+        if (depth >= MAX_DEPTH) {
+          return false;
+        }
+        pos_++;
+        const char close = c == '{' ? '}' : ']';
+        if (consume(close)) {
+          return true;
+        }
+        do {
+          if (c == '{' && !(peek('"') && string(nullptr) && consume(':'))) {
+            return false;
+          }
+          if (!skipValue(depth + 1)) {
+            return false;
+          }
+        } while (consume(','));
+        return consume(close);
+      }
+      return literal("true") || literal("false") || literal("null") ||
+             number();
+    }
+};
+
+bool scanRequest(const std::string& payload, Request& request) {
+  Scanner scanner(payload);
+  if (!scanner.consume('{')) {
+    return false;
+  }
+  request.empty = true;
+  if (!scanner.peek('}')) {
+    request.empty = false;
+    do {
+      std::string key;
+      if (!scanner.string(&key) || !scanner.consume(':')) {
+        return false;
+      }
+      std::string* field = nullptr;
+      if (key == "text_tokenized") {
+        field = &request.text;
+      } else if (key == "text") {
+        field = &request.raw;
+      } else if (key == "result_queue") {
+        field = &request.resultQueue;
+      } else if (key == "mode") {
+        field = &request.mode;
+      } else if (key == "encoding") {
+        field = &request.encoding;
+      } else if (key == VECTOR_FIELD || key == VECTOR_B64_FIELD) {
+        // would need to be replaced rather than appended
+        request.splice = false;
+      }
+      if (field && scanner.peek('"')) {
+        field->clear();
+        if (!scanner.string(field)) {
+          return false;
+        }
+      } else if (!scanner.skipValue()) {
+        return false;
+      }
+    } while (scanner.consume(','));
+  }
+  if (!scanner.peek('}')) {
+    return false;
+  }
+  request.end = scanner.pos();
+  scanner.consume('}');
+  scanner.skipSpace();
+  return scanner.pos() == payload.size();
+}
+
+std::string vectorToJson(const Vector& vec) {
+  std::string out("[");
+  char buf[32];
+  for (int64_t j = 0; j < vec.m_; j++) {
+    if (!std::isfinite(vec.data_[j])) {
+      return "[]";
+    }
+    int len = snprintf(buf, sizeof(buf), "%.9g", vec.data_[j]);
+    if (j > 0) {
+      out.push_back(',');
+    }
+    out.append(buf, len);
+  }
+  out.push_back(']');
+  return out;
+}
+
+std::string vectorToBase64(const Vector& vec, bool half) {
+  std::string bytes;
+  for (int64_t j = 0; j < vec.m_; j++) {
+    if (!std::isfinite(vec.data_[j])) {
+      return "";
+    }
+    if (half) {
+      uint16_t h = utils::floatToHalf(vec.data_[j]);
+      bytes.append((const char*) &h, sizeof(uint16_t));
+    } else {
+      float f = vec.data_[j];
+      bytes.append((const char*) &f, sizeof(float));
+    }
+  }
+  return utils::base64(bytes.data(), bytes.size());
+}
+
+}
+
+bool parseRequest(const std::string& payload, Request& request) {
+  request = Request();
+  request.splice = true;
+  if (scanRequest(payload, request)) {
+    return true;
+  }
+  // Not something the scanner understands: let the JSON library decide.
+  nlohmann::json obj;
+  try {
+    obj = nlohmann::json::parse(payload);
+  } catch (const std::exception&) {
+    return false;
+  }
+  if (!obj.is_object()) {
+    return false;
+  }
+  request = Request();
+  request.splice = false;
+  if (obj.count("text_tokenized") && obj["text_tokenized"].is_string()) {
+    request.text = obj["text_tokenized"];
+  }
+  if (obj.count("text") && obj["text"].is_string()) {
+    request.raw = obj["text"];
+  }
+  if (obj.count("result_queue") && obj["result_queue"].is_string()) {
+    request.resultQueue = obj["result_queue"];
+  }
+  if (obj.count("mode") && obj["mode"].is_string()) {
+    request.mode = obj["mode"];
+  }
+  if (obj.count("encoding") && obj["encoding"].is_string()) {
+    request.encoding = obj["encoding"];
+  }
+  return true;
+}
+
+std::string encodeResponse(const std::string& payload, const Request& request,
+                           const Vector& vec) {
+  const bool binary = request.encoding == "f32" || request.encoding == "f16";
+  if (request.splice) {
+    std::string field = binary ? VECTOR_B64_FIELD : VECTOR_FIELD;
+    std::string value = binary ?
+      "\"" + vectorToBase64(vec, request.encoding == "f16") + "\"" :
+      vectorToJson(vec);
+    std::string out;
+    out.reserve(payload.size() + field.size() + value.size() + 4);
+    out.append(payload, 0, request.end);
+    if (!request.empty) {
+      out.push_back(',');
+    }
+    out.push_back('"');
+    out.append(field);
+    out.append("\":");
+    out.append(value);
+    out.append(payload, request.end, std::string::npos);
+    return out;
+  }
+  nlohmann::json obj = nlohmann::json::parse(payload);
+  if (binary) {
+    obj[VECTOR_B64_FIELD] = vectorToBase64(vec, request.encoding == "f16");
+  } else {
+    std::vector<float> embedding;
+    for (int64_t j = 0; j < vec.m_; j++) {
+      if (!std::isfinite(vec.data_[j])) {
+        embedding.clear();
+        break;
+      }
+      embedding.push_back(vec.data_[j]);
+    }
+    obj[VECTOR_FIELD] = embedding;
+  }
+  return obj.dump();
+}
+
+std::string encodeError(const std::string& error) {
+  nlohmann::json obj;
+  obj["error"] = error;
+  return obj.dump();
+}
+
+}
@@ -0,0 +1,42 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_REQUEST_H
+#define FASTTEXT_REQUEST_H
+
+#include <string>
+
+#include "vector.h"
+
+namespace fasttext {
+
+// The fields of a redis-mode request that the server reads. Everything else
+// in the payload is passed through to the response untouched.
+struct Request {
+  std::string text;
+  // raw text, tokenized by the server when text_tokenized is not given
+  std::string raw;
+  std::string resultQueue;
+  std::string mode;
+  std::string encoding;
+
+  // Offset of the closing brace of the payload object, and whether the
+  // response can be built by inserting the vector field before it.
+  size_t end;
+  bool empty;
+  bool splice;
+};
+
+bool parseRequest(const std::string&, Request&);
+std::string encodeResponse(const std::string&, const Request&, const Vector&);
+std::string encodeError(const std::string&);
+
+}
+
+#endif
@@ -0,0 +1,386 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "vector.h"
+
+namespace fasttext {
+
+namespace {
+
+uint32_t readLength(const char* p) {
+  const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+  return uint32_t(b[0]) | uint32_t(b[1]) << 8 | uint32_t(b[2]) << 16 |
+         uint32_t(b[3]) << 24;
+}
+
+int64_t nanoseconds(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+void appendLength(std::string& out, uint32_t n) {
+  out.push_back(char(n & 0xff));
+  out.push_back(char((n >> 8) & 0xff));
+  out.push_back(char((n >> 16) & 0xff));
+  out.push_back(char((n >> 24) & 0xff));
+}
+
+}
+
+EmbeddingServer::Connection::Connection(int fd)
+  : fd(fd), received(0), reading(true), sent(0), broken(false) {}
+
+EmbeddingServer::Connection::~Connection() {
+  close(fd);
+}
+
+EmbeddingServer::EmbeddingServer(const FastText& fasttext, int32_t threads,
+                                 int32_t maxBatch, int64_t maxWait)
+  : fasttext_(fasttext), threads_(std::max(threads, 1)),
+    maxBatch_(std::max(maxBatch, 1)), maxWait_(maxWait), metrics_(nullptr),
+    tokenize_(false), stop_(false) {}
+
+EmbeddingServer::~EmbeddingServer() {
+  for (auto it = listenFds_.cbegin(); it != listenFds_.cend(); ++it) {
+    close(*it);
+  }
+  if (!unixPath_.empty()) {
+    unlink(unixPath_.c_str());
+  }
+}
+
+void EmbeddingServer::listenUnix(const std::string& path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Socket path is too long: " << path << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path.c_str());
+  if (fd < 0 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    std::cerr << "Cannot listen on " << path << ": " << strerror(errno)
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  listenFds_.push_back(fd);
+  unixPath_ = path;
+}
+
+void EmbeddingServer::listenTcp(const std::string& host, int32_t port) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  struct addrinfo* info = nullptr;
+  const std::string service = std::to_string(port);
+  if (getaddrinfo(host.c_str(), service.c_str(), &hints, &info) != 0) {
+    std::cerr << "Cannot resolve " << host << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  int fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if (fd < 0 || bind(fd, info->ai_addr, info->ai_addrlen) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    std::cerr << "Cannot listen on " << host << ":" << port << ": "
+              << strerror(errno) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  freeaddrinfo(info);
+  listenFds_.push_back(fd);
+}
+
+void EmbeddingServer::listen(const std::string& unixPath,
+                             const std::string& host, int32_t port) {
+  if (!unixPath.empty()) {
+    listenUnix(unixPath);
+  }
+  if (port > 0) {
+    listenTcp(host, port);
+  }
+}
+
+void EmbeddingServer::setMetrics(Metrics* metrics) {
+  metrics_ = metrics;
+}
+
+void EmbeddingServer::setTokenize(bool tokenize) {
+  tokenize_ = tokenize;
+}
+
+bool EmbeddingServer::receive(const std::shared_ptr<Connection>& connection,
+                              MetricsShard& metrics) {
+  char buffer[65536];
+  ssize_t n = read(connection->fd, buffer, sizeof(buffer));
+  if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+    return true;
+  }
+  if (n <= 0) {
+    return false;
+  }
+  std::string& data = connection->buffer;
+  data.append(buffer, n);
+  std::vector<Job> jobs;
+  size_t pos = 0;
+  while (data.size() - pos >= 4) {
+    uint32_t size = readLength(data.data() + pos);
+    if (size > MAX_REQUEST_SIZE) {
+      metrics.error(request_error::too_large);
+      std::cerr << "Request of " << size << " bytes, closing connection"
+                << std::endl;
+      return false;
+    }
+    if (data.size() - pos - 4 < size) {
+      break;
+    }
+    jobs.emplace_back();
+    Job& job = jobs.back();
+    job.connection = connection;
+    job.seq = connection->received++;
+    job.text.assign(data, pos + 4, size);
+    pos += 4 + size;
+  }
+  data.erase(0, pos);
+  if (!jobs.empty()) {
+    const clock::time_point now = clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+      it->arrival = now;
+      jobs_.push_back(std::move(*it));
+    }
+    if (jobs_.size() >= maxBatch_ || jobs.size() > 1) {
+      cv_.notify_all();
+    } else {
+      cv_.notify_one();
+    }
+  }
+  return true;
+}
+
+void EmbeddingServer::respond(
+    Connection& connection,
+    std::vector<std::pair<uint64_t, std::string>>& responses) {
+  std::unique_lock<std::mutex> lock(connection.mutex);
+  if (connection.broken) {
+    return;
+  }
+  for (auto it = responses.begin(); it != responses.end(); ++it) {
+    connection.done[it->first].swap(it->second);
+  }
+  auto it = connection.done.begin();
+  while (it != connection.done.end() && it->first == connection.sent) {
+    connection.pending.append(it->second);
+    it = connection.done.erase(it);
+    connection.sent++;
+  }
+  write(connection);
+}
+
+// Sends as much of the pending output as the socket takes without blocking.
+// The caller holds the mutex of the connection.
+void EmbeddingServer::write(Connection& connection) {
+  std::string& out = connection.pending;
+  size_t written = 0;
+  while (written < out.size()) {
+    ssize_t n = send(connection.fd, out.data() + written, out.size() - written,
+                     MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (n <= 0) {
+      connection.broken = true;
+      connection.done.clear();
+      out.clear();
+      return;
+    }
+    written += n;
+  }
+  out.erase(0, written);
+}
+
+void EmbeddingServer::worker() {
+  MetricsShard own;
+  MetricsShard& metrics = metrics_ ? *metrics_->shard() : own;
+  std::minstd_rand rng(0);
+  std::vector<int32_t> line;
+  Tokenizer tokenizer;
+  std::string tokens;
+  Vector vec(fasttext_.getDimension());
+  const uint32_t bytes = vec.m_ * sizeof(real);
+  std::vector<Job> batch;
+  std::vector<std::pair<uint64_t, std::string>> responses;
+  while (true) {
+    batch.clear();
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+      if (jobs_.empty()) {
+        return;
+      }
+      if (jobs_.size() < maxBatch_ && maxWait_.count() > 0) {
+        cv_.wait_until(lock, jobs_.front().arrival + maxWait_, [this]() {
+          return stop_ || jobs_.empty() || jobs_.size() >= maxBatch_;
+        });
+        if (jobs_.empty()) {
+          continue;
+        }
+      }
+      const size_t n = std::min(jobs_.size(), maxBatch_);
+      for (size_t i = 0; i < n; i++) {
+        batch.push_back(std::move(jobs_.front()));
+        jobs_.pop_front();
+      }
+      if (!jobs_.empty()) {
+        cv_.notify_one();
+      }
+    }
+
+    clock::time_point t = clock::now();
+    metrics.batchSize.observe(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+      metrics.requests.add(1);
+      metrics.queueWait.observe(nanoseconds(t - batch[i].arrival));
+      if (tokenize_) {
+        tokenizer.preprocess(batch[i].text, tokens);
+      }
+      std::istringstream iss(tokenize_ ? tokens : batch[i].text);
+      fasttext_.sentenceTokens(iss, line, rng);
+      clock::time_point tokenized = clock::now();
+      metrics.time(stage::tokenize, nanoseconds(tokenized - t));
+      fasttext_.tokensVector(line, vec);
+      clock::time_point embedded = clock::now();
+      metrics.time(stage::embed, nanoseconds(embedded - tokenized));
+      responses.emplace_back(batch[i].seq, std::string());
+      std::string& frame = responses.back().second;
+      frame.reserve(4 + bytes);
+      appendLength(frame, bytes);
+      frame.append(reinterpret_cast<const char*>(vec.data_), bytes);
+      t = clock::now();
+      metrics.time(stage::encode, nanoseconds(t - embedded));
+      // one write for the consecutive requests of a connection
+      if (i + 1 == batch.size() ||
+          batch[i + 1].connection != batch[i].connection) {
+        respond(*batch[i].connection, responses);
+        responses.clear();
+      }
+    }
+  }
+}
+
+void EmbeddingServer::run() {
+  MetricsShard own;
+  MetricsShard& metrics = metrics_ ? *metrics_->shard() : own;
+  std::vector<std::thread> workers;
+  for (int32_t i = 0; i < threads_; i++) {
+    workers.push_back(std::thread([this]() { worker(); }));
+  }
+  std::vector<std::shared_ptr<Connection>> connections;
+  std::vector<struct pollfd> fds;
+  const size_t nlisten = listenFds_.size();
+  while (!stop_) {
+    fds.clear();
+    for (size_t i = 0; i < nlisten; i++) {
+      fds.push_back({listenFds_[i], POLLIN, 0});
+    }
+    // a connection stays open until the responses it is owed are written
+    for (size_t i = connections.size(); i-- > 0;) {
+      Connection& connection = *connections[i];
+      std::unique_lock<std::mutex> lock(connection.mutex);
+      if (connection.broken ||
+          (!connection.reading && connection.sent == connection.received &&
+           connection.pending.empty())) {
+        lock.unlock();
+        connections.erase(connections.begin() + i);
+      }
+    }
+    for (size_t i = 0; i < connections.size(); i++) {
+      Connection& connection = *connections[i];
+      std::unique_lock<std::mutex> lock(connection.mutex);
+      short events = 0;
+      if (connection.reading && connection.pending.size() < MAX_PENDING) {
+        events |= POLLIN;
+      }
+      if (!connection.pending.empty()) {
+        events |= POLLOUT;
+      }
+      // a client that is done sending and owed nothing yet is left alone
+      fds.push_back({events != 0 ? connection.fd : -1, events, 0});
+    }
+    if (poll(fds.data(), fds.size(), 100) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "poll failed: " << strerror(errno) << std::endl;
+      break;
+    }
+    for (size_t i = 0; i < connections.size(); i++) {
+      Connection& connection = *connections[i];
+      const short revents = fds[nlisten + i].revents;
+      if (revents & (POLLOUT | POLLERR | POLLHUP)) {
+        std::unique_lock<std::mutex> lock(connection.mutex);
+        if (!connection.broken) {
+          write(connection);
+        }
+      }
+      if ((revents & (POLLIN | POLLERR | POLLHUP)) && connection.reading &&
+          !receive(connections[i], metrics)) {
+        connection.reading = false;
+      }
+    }
+    for (size_t i = 0; i < nlisten; i++) {
+      if (fds[i].revents & POLLIN) {
+        int fd = accept(listenFds_[i], nullptr, nullptr);
+        if (fd >= 0) {
+          int one = 1;
+          setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+          fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+          connections.push_back(std::make_shared<Connection>(fd));
+        }
+      }
+    }
+  }
+  stop();
+  for (auto it = workers.begin(); it != workers.end(); ++it) {
+    it->join();
+  }
+}
+
+void EmbeddingServer::stop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  stop_ = true;
+  cv_.notify_all();
+}
+
+}
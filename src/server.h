@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_SERVER_H
+#define FASTTEXT_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fasttext.h"
+#include "metrics.h"
+#include "tokenizer.h"
+
+namespace fasttext {
+
+// Embedding server for local clients over a Unix domain socket and/or TCP.
+//
+// A request is a little-endian uint32 length followed by that many bytes of
+// tokenized text, or of raw text when the server tokenizes. The response is
+// a uint32 length followed by the sentence vector as little-endian float32.
+// Clients may send any number of requests before reading, and get the
+// responses in request order.
+//
+// One thread reads requests off all connections. Worker threads take them
+// in micro-batches of at most maxBatch requests, waiting up to maxWait for
+// a batch to fill once the first request of it has arrived. Sockets are
+// non-blocking: responses a client does not take right away wait on its
+// connection until the polling thread can write them, and that thread stops
+// reading requests from a client while MAX_PENDING bytes are waiting.
+class EmbeddingServer {
+  public:
+    static const uint32_t MAX_REQUEST_SIZE = 1 << 24;
+    static const size_t MAX_PENDING = 1 << 24;
+
+  private:
+    typedef std::chrono::steady_clock clock;
+
+    struct Connection {
+      int fd;
+      std::string buffer;
+      uint64_t received;
+      // false once the client has closed its side
+      bool reading;
+      // responses that are ready but wait for an earlier one
+      std::mutex mutex;
+      std::map<uint64_t, std::string> done;
+      uint64_t sent;
+      // responses, in order, that the socket did not take yet
+      std::string pending;
+      bool broken;
+
+      explicit Connection(int);
+      ~Connection();
+    };
+
+    struct Job {
+      std::shared_ptr<Connection> connection;
+      uint64_t seq;
+      std::string text;
+      clock::time_point arrival;
+    };
+
+    const FastText& fasttext_;
+    int32_t threads_;
+    size_t maxBatch_;
+    std::chrono::microseconds maxWait_;
+    std::vector<int> listenFds_;
+    std::string unixPath_;
+    Metrics* metrics_;
+    bool tokenize_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> jobs_;
+    std::atomic<bool> stop_;
+
+    void listenUnix(const std::string&);
+    void listenTcp(const std::string&, int32_t);
+    bool receive(const std::shared_ptr<Connection>&, MetricsShard&);
+    void worker();
+    void respond(Connection&, std::vector<std::pair<uint64_t, std::string>>&);
+    void write(Connection&);
+
+  public:
+    EmbeddingServer(const FastText&, int32_t, int32_t, int64_t);
+    ~EmbeddingServer();
+
+    void listen(const std::string&, const std::string&, int32_t);
+    void setMetrics(Metrics*);
+    void setTokenize(bool);
+    void run();
+    void stop();
+};
+
+}
+
+#endif
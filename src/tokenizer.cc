@@ -0,0 +1,1019 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace fasttext {
+
+namespace {
+
+// code point past the end of the text
+const uint32_t END = 0x110000;
+
+struct Entity {
+  const char* name;
+  uint32_t cp;
+};
+
+// Python's html.entities.name2codepoint, sorted by name
+const Entity ENTITIES[] = {
+  {"AElig", 0xc6}, {"Aacute", 0xc1}, {"Acirc", 0xc2}, {"Agrave", 0xc0},
+  {"Alpha", 0x391}, {"Aring", 0xc5}, {"Atilde", 0xc3}, {"Auml", 0xc4},
+  {"Beta", 0x392}, {"Ccedil", 0xc7}, {"Chi", 0x3a7}, {"Dagger", 0x2021},
+  {"Delta", 0x394}, {"ETH", 0xd0}, {"Eacute", 0xc9}, {"Ecirc", 0xca},
+  {"Egrave", 0xc8}, {"Epsilon", 0x395}, {"Eta", 0x397}, {"Euml", 0xcb},
+  {"Gamma", 0x393}, {"Iacute", 0xcd}, {"Icirc", 0xce}, {"Igrave", 0xcc},
+  {"Iota", 0x399}, {"Iuml", 0xcf}, {"Kappa", 0x39a}, {"Lambda", 0x39b},
+  {"Mu", 0x39c}, {"Ntilde", 0xd1}, {"Nu", 0x39d}, {"OElig", 0x152},
+  {"Oacute", 0xd3}, {"Ocirc", 0xd4}, {"Ograve", 0xd2}, {"Omega", 0x3a9},
+  {"Omicron", 0x39f}, {"Oslash", 0xd8}, {"Otilde", 0xd5}, {"Ouml", 0xd6},
+  {"Phi", 0x3a6}, {"Pi", 0x3a0}, {"Prime", 0x2033}, {"Psi", 0x3a8},
+  {"Rho", 0x3a1}, {"Scaron", 0x160}, {"Sigma", 0x3a3}, {"THORN", 0xde},
+  {"Tau", 0x3a4}, {"Theta", 0x398}, {"Uacute", 0xda}, {"Ucirc", 0xdb},
+  {"Ugrave", 0xd9}, {"Upsilon", 0x3a5}, {"Uuml", 0xdc}, {"Xi", 0x39e},
+  {"Yacute", 0xdd}, {"Yuml", 0x178}, {"Zeta", 0x396}, {"aacute", 0xe1},
+  {"acirc", 0xe2}, {"acute", 0xb4}, {"aelig", 0xe6}, {"agrave", 0xe0},
+  {"alefsym", 0x2135}, {"alpha", 0x3b1}, {"amp", 0x26}, {"and", 0x2227},
+  {"ang", 0x2220}, {"aring", 0xe5}, {"asymp", 0x2248}, {"atilde", 0xe3},
+  {"auml", 0xe4}, {"bdquo", 0x201e}, {"beta", 0x3b2}, {"brvbar", 0xa6},
+  {"bull", 0x2022}, {"cap", 0x2229}, {"ccedil", 0xe7}, {"cedil", 0xb8},
+  {"cent", 0xa2}, {"chi", 0x3c7}, {"circ", 0x2c6}, {"clubs", 0x2663},
+  {"cong", 0x2245}, {"copy", 0xa9}, {"crarr", 0x21b5}, {"cup", 0x222a},
+  {"curren", 0xa4}, {"dArr", 0x21d3}, {"dagger", 0x2020}, {"darr", 0x2193},
+  {"deg", 0xb0}, {"delta", 0x3b4}, {"diams", 0x2666}, {"divide", 0xf7},
+  {"eacute", 0xe9}, {"ecirc", 0xea}, {"egrave", 0xe8}, {"empty", 0x2205},
+  {"emsp", 0x2003}, {"ensp", 0x2002}, {"epsilon", 0x3b5}, {"equiv", 0x2261},
+  {"eta", 0x3b7}, {"eth", 0xf0}, {"euml", 0xeb}, {"euro", 0x20ac},
+  {"exist", 0x2203}, {"fnof", 0x192}, {"forall", 0x2200}, {"frac12", 0xbd},
+  {"frac14", 0xbc}, {"frac34", 0xbe}, {"frasl", 0x2044}, {"gamma", 0x3b3},
+  {"ge", 0x2265}, {"gt", 0x3e}, {"hArr", 0x21d4}, {"harr", 0x2194},
+  {"hearts", 0x2665}, {"hellip", 0x2026}, {"iacute", 0xed}, {"icirc", 0xee},
+  {"iexcl", 0xa1}, {"igrave", 0xec}, {"image", 0x2111}, {"infin", 0x221e},
+  {"int", 0x222b}, {"iota", 0x3b9}, {"iquest", 0xbf}, {"isin", 0x2208},
+  {"iuml", 0xef}, {"kappa", 0x3ba}, {"lArr", 0x21d0}, {"lambda", 0x3bb},
+  {"lang", 0x2329}, {"laquo", 0xab}, {"larr", 0x2190}, {"lceil", 0x2308},
+  {"ldquo", 0x201c}, {"le", 0x2264}, {"lfloor", 0x230a}, {"lowast", 0x2217},
+  {"loz", 0x25ca}, {"lrm", 0x200e}, {"lsaquo", 0x2039}, {"lsquo", 0x2018},
+  {"lt", 0x3c}, {"macr", 0xaf}, {"mdash", 0x2014}, {"micro", 0xb5},
+  {"middot", 0xb7}, {"minus", 0x2212}, {"mu", 0x3bc}, {"nabla", 0x2207},
+  {"nbsp", 0xa0}, {"ndash", 0x2013}, {"ne", 0x2260}, {"ni", 0x220b},
+  {"not", 0xac}, {"notin", 0x2209}, {"nsub", 0x2284}, {"ntilde", 0xf1},
+  {"nu", 0x3bd}, {"oacute", 0xf3}, {"ocirc", 0xf4}, {"oelig", 0x153},
+  {"ograve", 0xf2}, {"oline", 0x203e}, {"omega", 0x3c9}, {"omicron", 0x3bf},
+  {"oplus", 0x2295}, {"or", 0x2228}, {"ordf", 0xaa}, {"ordm", 0xba},
+  {"oslash", 0xf8}, {"otilde", 0xf5}, {"otimes", 0x2297}, {"ouml", 0xf6},
+  {"para", 0xb6}, {"part", 0x2202}, {"permil", 0x2030}, {"perp", 0x22a5},
+  {"phi", 0x3c6}, {"pi", 0x3c0}, {"piv", 0x3d6}, {"plusmn", 0xb1},
+  {"pound", 0xa3}, {"prime", 0x2032}, {"prod", 0x220f}, {"prop", 0x221d},
+  {"psi", 0x3c8}, {"quot", 0x22}, {"rArr", 0x21d2}, {"radic", 0x221a},
+  {"rang", 0x232a}, {"raquo", 0xbb}, {"rarr", 0x2192}, {"rceil", 0x2309},
+  {"rdquo", 0x201d}, {"real", 0x211c}, {"reg", 0xae}, {"rfloor", 0x230b},
+  {"rho", 0x3c1}, {"rlm", 0x200f}, {"rsaquo", 0x203a}, {"rsquo", 0x2019},
+  {"sbquo", 0x201a}, {"scaron", 0x161}, {"sdot", 0x22c5}, {"sect", 0xa7},
+  {"shy", 0xad}, {"sigma", 0x3c3}, {"sigmaf", 0x3c2}, {"sim", 0x223c},
+  {"spades", 0x2660}, {"sub", 0x2282}, {"sube", 0x2286}, {"sum", 0x2211},
+  {"sup", 0x2283}, {"sup1", 0xb9}, {"sup2", 0xb2}, {"sup3", 0xb3},
+  {"supe", 0x2287}, {"szlig", 0xdf}, {"tau", 0x3c4}, {"there4", 0x2234},
+  {"theta", 0x3b8}, {"thetasym", 0x3d1}, {"thinsp", 0x2009}, {"thorn", 0xfe},
+  {"tilde", 0x2dc}, {"times", 0xd7}, {"trade", 0x2122}, {"uArr", 0x21d1},
+  {"uacute", 0xfa}, {"uarr", 0x2191}, {"ucirc", 0xfb}, {"ugrave", 0xf9},
+  {"uml", 0xa8}, {"upsih", 0x3d2}, {"upsilon", 0x3c5}, {"uuml", 0xfc},
+  {"weierp", 0x2118}, {"xi", 0x3be}, {"yacute", 0xfd}, {"yen", 0xa5},
+  {"yuml", 0xff}, {"zeta", 0x3b6}, {"zwj", 0x200d}, {"zwnj", 0x200c}
+};
+
+// Windows-1252 for 0x80-0x9f, which numeric references in that range are
+// taken to mean; 0 where it has no character
+const uint32_t CP1252[] = {
+  0x20ac, 0, 0x201a, 0x192, 0x201e, 0x2026, 0x2020, 0x2021,
+  0x2c6, 0x2030, 0x160, 0x2039, 0x152, 0, 0x17d, 0,
+  0, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+  0x2dc, 0x2122, 0x161, 0x203a, 0x153, 0, 0x17e, 0x178};
+
+// Decodes the code point at s[i] and returns its length in bytes. A byte
+// that does not start a valid sequence stands for itself; past the end of
+// s the code point is END and the length 0.
+size_t decode(const std::string& s, size_t i, uint32_t& cp) {
+  if (i >= s.size()) {
+    cp = END;
+    return 0;
+  }
+  const unsigned char c = s[i];
+  cp = c;
+  if (c < 0xc0 || c >= 0xf8) {
+    return 1;
+  }
+  const size_t len = c < 0xe0 ? 2 : c < 0xf0 ? 3 : 4;
+  if (i + len > s.size()) {
+    return 1;
+  }
+  uint32_t value = c & (0x3f >> (len - 1));
+  for (size_t k = 1; k < len; k++) {
+    const unsigned char d = s[i + k];
+    if ((d & 0xc0) != 0x80) {
+      return 1;
+    }
+    value = (value << 6) | (d & 0x3f);
+  }
+  cp = value;
+  return len;
+}
+
+uint32_t codepoint(const std::string& s, size_t i) {
+  uint32_t cp;
+  decode(s, i, cp);
+  return cp;
+}
+
+void encode(std::string& out, uint32_t cp) {
+  if (cp < 0x80) {
+    out.push_back(char(cp));
+  } else if (cp < 0x800) {
+    out.push_back(char(0xc0 | (cp >> 6)));
+    out.push_back(char(0x80 | (cp & 0x3f)));
+  } else if (cp < 0x10000) {
+    out.push_back(char(0xe0 | (cp >> 12)));
+    out.push_back(char(0x80 | ((cp >> 6) & 0x3f)));
+    out.push_back(char(0x80 | (cp & 0x3f)));
+  } else {
+    out.push_back(char(0xf0 | (cp >> 18)));
+    out.push_back(char(0x80 | ((cp >> 12) & 0x3f)));
+    out.push_back(char(0x80 | ((cp >> 6) & 0x3f)));
+    out.push_back(char(0x80 | (cp & 0x3f)));
+  }
+}
+
+// \s: the White_Space property
+bool isSpace(uint32_t cp) {
+  return (cp >= 0x09 && cp <= 0x0d) || cp == ' ' || cp == 0x85 ||
+         cp == 0xa0 || cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200a) ||
+         cp == 0x2028 || cp == 0x2029 || cp == 0x202f || cp == 0x205f ||
+         cp == 0x3000;
+}
+
+bool isDigit(uint32_t cp) {
+  return cp >= '0' && cp <= '9';
+}
+
+bool isAsciiAlpha(uint32_t cp) {
+  return (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z');
+}
+
+bool isAsciiAlnum(uint32_t cp) {
+  return isAsciiAlpha(cp) || isDigit(cp);
+}
+
+// \w: letters, marks, digits and connector punctuation. Beyond Latin-1
+// every code point counts except the blocks of punctuation, symbols and
+// emoji.
+bool isWord(uint32_t cp) {
+  if (cp < 0x80) {
+    return isAsciiAlnum(cp) || cp == '_';
+  }
+  if (cp < 0x100) {
+    return cp == 0xaa || cp == 0xb5 || cp == 0xba ||
+           (cp >= 0xc0 && cp != 0xd7 && cp != 0xf7);
+  }
+  if (cp >= 0x2000 && cp <= 0x2bff) {
+    return cp == 0x200c || cp == 0x200d || cp == 0x203f || cp == 0x2040 ||
+           cp == 0x2054 || cp == 0x2071 || cp == 0x207f ||
+           (cp >= 0x2090 && cp <= 0x209c) || (cp >= 0x20d0 && cp <= 0x20f0) ||
+           (cp >= 0x2160 && cp <= 0x2188) || (cp >= 0x24b6 && cp <= 0x24e9);
+  }
+  if (cp >= 0x2e00 && cp <= 0x2e7f) {
+    return false;
+  }
+  if (cp >= 0x3000 && cp <= 0x303f) {
+    return (cp >= 0x3005 && cp <= 0x3007) || (cp >= 0x3021 && cp <= 0x302f) ||
+           (cp >= 0x3031 && cp <= 0x3035) || (cp >= 0x3038 && cp <= 0x303c);
+  }
+  if (cp >= 0xfe10 && cp <= 0xfe6f) {
+    return (cp >= 0xfe20 && cp <= 0xfe2f) || cp == 0xfe33 || cp == 0xfe34 ||
+           (cp >= 0xfe4d && cp <= 0xfe4f);
+  }
+  if (cp >= 0xff00 && cp <= 0xff65) {
+    // fullwidth forms of ASCII
+    return cp >= 0xff01 && cp <= 0xff5e && isWord(cp - 0xfee0);
+  }
+  return !(cp >= 0xfff0 && cp <= 0xffff) && !(cp >= 0x1f000 && cp <= 0x1faff) &&
+         !(cp >= 0xe0000 && cp <= 0xe007f) && cp != END;
+}
+
+// [^\W\d_]
+bool isLetter(uint32_t cp) {
+  return isWord(cp) && !isDigit(cp) && cp != '_';
+}
+
+uint32_t lower(uint32_t cp) {
+  if (cp < 0x80) {
+    return cp >= 'A' && cp <= 'Z' ? cp + 32 : cp;
+  }
+  if (cp >= 0xc0 && cp <= 0xde && cp != 0xd7) {
+    return cp + 32;
+  }
+  if (cp >= 0x100 && cp <= 0x17f) {
+    if (cp == 0x130 || cp == 0x138) {
+      return cp;
+    }
+    if (cp == 0x178) {
+      return 0xff;
+    }
+    const bool odd = (cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17e);
+    return cp % 2 == (odd ? 1u : 0u) ? cp + 1 : cp;
+  }
+  if (cp >= 0x1c4 && cp <= 0x1cb) {
+    // the digraphs DŽ Dž LJ Lj NJ Nj
+    return cp + 2 - (cp - 0x1c4) % 3;
+  }
+  if (cp >= 0x386 && cp <= 0x3ab) {
+    if (cp == 0x386) {
+      return 0x3ac;
+    } else if (cp >= 0x388 && cp <= 0x38a) {
+      return cp + 37;
+    } else if (cp == 0x38c) {
+      return 0x3cc;
+    } else if (cp == 0x38e || cp == 0x38f) {
+      return cp + 63;
+    } else if (cp >= 0x391 && cp != 0x3a2) {
+      return cp + 32;
+    }
+    return cp;
+  }
+  if (cp >= 0x400 && cp <= 0x40f) {
+    return cp + 80;
+  }
+  if (cp >= 0x410 && cp <= 0x42f) {
+    return cp + 32;
+  }
+  if ((cp >= 0x3d8 && cp <= 0x3ef) || (cp >= 0x460 && cp <= 0x481) ||
+      (cp >= 0x48a && cp <= 0x4bf) || (cp >= 0x4d0 && cp <= 0x52f)) {
+    return cp % 2 == 0 ? cp + 1 : cp;
+  }
+  if (cp >= 0x4c0 && cp <= 0x4ce) {
+    return cp == 0x4c0 ? 0x4cf : cp % 2 == 1 ? cp + 1 : cp;
+  }
+  if (cp >= 0x531 && cp <= 0x556) {
+    return cp + 48;
+  }
+  if ((cp >= 0x1e00 && cp <= 0x1e95) || (cp >= 0x1ea0 && cp <= 0x1eff)) {
+    return cp % 2 == 0 ? cp + 1 : cp;
+  }
+  if (cp == 0x1e9e) {
+    return 0xdf;
+  }
+  if (cp >= 0xff21 && cp <= 0xff3a) {
+    return cp + 32;
+  }
+  return cp;
+}
+
+bool startsWith(const std::string& s, size_t i, const char* prefix) {
+  const size_t n = strlen(prefix);
+  return s.size() - std::min(i, s.size()) >= n && s.compare(i, n, prefix) == 0;
+}
+
+// End of the run of code points satisfying pred from p.
+template <typename Pred>
+size_t skip(const std::string& s, size_t p, Pred pred) {
+  uint32_t cp;
+  size_t len;
+  while ((len = decode(s, p, cp)) > 0 && pred(cp)) {
+    p += len;
+  }
+  return p;
+}
+
+bool isUrlPunct(uint32_t cp) {
+  return (cp < 0x80 && strchr("`!()[]{};:'\".,<>?", char(cp)) != nullptr &&
+          cp != 0) ||
+         cp == 0xab || cp == 0xbb || cp == 0x2018 || cp == 0x2019 ||
+         cp == 0x201c || cp == 0x201d;
+}
+
+// Parenthesized part of a url at s[q] == '(', one level deep.
+size_t nestedParens(const std::string& s, size_t q) {
+  auto plain = [](uint32_t cp) {
+    return cp != '(' && cp != ')' && !isSpace(cp) && cp != END;
+  };
+  size_t p = skip(s, q + 1, plain);
+  if (s[p] == '(') {
+    size_t r = skip(s, p + 1, plain);
+    if (r > p + 1 && s[r] == ')') {
+      r = skip(s, r + 1, plain);
+      if (s[r] == ')') {
+        return r + 1;
+      }
+    }
+  }
+  return q;
+}
+
+// Parenthesized part of a url at s[q] == '(', not nested: the shortest one
+// that ends after the given position, or q.
+size_t plainParens(const std::string& s, size_t q, size_t after) {
+  uint32_t cp;
+  size_t len;
+  for (size_t p = q + 1; (len = decode(s, p, cp)) > 0 && !isSpace(cp);
+       p += len) {
+    if (cp == ')' && p > q + 1 && p >= after) {
+      return p + 1;
+    }
+  }
+  return q;
+}
+
+bool isUrlRun(uint32_t cp) {
+  return cp != END && !isSpace(cp) &&
+         (cp > 0x7f || cp == 0 || strchr("()<>{}[]", char(cp)) == nullptr);
+}
+
+// The rest of a url after its scheme or domain: runs of characters and
+// parenthesized parts, ending in one of the latter or in a character that
+// is not punctuation. Tries the alternatives in the order the regular
+// expression backtracks through them, so that (c(d)e)! ends after e.
+class UrlBody {
+  private:
+    static const int32_t MAX_DEPTH = 256;
+
+    const std::string& s_;
+    size_t start_;
+    std::vector<bool> failed_;
+
+  public:
+    UrlBody(const std::string& s, size_t start) : s_(s), start_(start) {}
+
+    // End of the match from pos, or npos; item tells if anything precedes.
+    size_t match(size_t pos, bool item, int32_t depth) {
+      uint32_t cp;
+      size_t len = decode(s_, pos, cp);
+      if (cp == '(') {
+        if (depth >= MAX_DEPTH || (item && !failed_.empty() && failed_[pos - start_])) {
+          return std::string::npos;
+        }
+        size_t end = std::string::npos;
+        const size_t nested = nestedParens(s_, pos);
+        if (nested > pos) {
+          end = match(nested, true, depth + 1);
+        }
+        for (size_t p = plainParens(s_, pos, pos); end == std::string::npos && p > pos;
+             p = plainParens(s_, pos, p)) {
+          end = match(p, true, depth + 1);
+        }
+        if (end == std::string::npos && item) {
+          const size_t last = nested > pos ? nested : plainParens(s_, pos, pos);
+          if (last > pos) {
+            return last;
+          }
+          if (failed_.empty()) {
+            failed_.resize(s_.size() - start_ + 1);
+          }
+          failed_[pos - start_] = true;
+        }
+        return end;
+      }
+      if (len == 0 || !isUrlRun(cp)) {
+        return std::string::npos;
+      }
+      const size_t run = skip(s_, pos, isUrlRun);
+      size_t end = match(run, true, depth);
+      if (end != std::string::npos) {
+        return end;
+      }
+      // a shorter run, ended by the character after it
+      for (size_t p = run; p > pos;) {
+        p--;
+        while (p > pos && (s_[p] & 0xc0) == 0x80) {
+          p--;
+        }
+        if ((p > pos || item) && !isUrlPunct(codepoint(s_, p))) {
+          return p + decode(s_, p, cp);
+        }
+      }
+      return std::string::npos;
+    }
+};
+
+size_t urlBody(const std::string& s, size_t p) {
+  UrlBody body(s, p);
+  size_t end = body.match(p, false, 0);
+  return end == std::string::npos ? p : end;
+}
+
+// What [a-z] matches case-insensitively folds to
+uint32_t fold(uint32_t cp) {
+  if (isAsciiAlpha(cp)) {
+    return cp | 0x20;
+  }
+  return cp == 0x130 ? 'i' : cp == 0x17f ? 's' : cp == 0x212a ? 'k' : cp;
+}
+
+bool isUrlAlpha(uint32_t cp) {
+  const uint32_t f = fold(cp);
+  return f >= 'a' && f <= 'z';
+}
+
+bool isUrlAlnum(uint32_t cp) {
+  return isUrlAlpha(cp) || isDigit(cp);
+}
+
+// Number of code points in s[p, q).
+size_t length(const std::string& s, size_t p, size_t q) {
+  size_t n = 0;
+  for (; p < q; p++) {
+    n += (s[p] & 0xc0) != 0x80;
+  }
+  return n;
+}
+
+// A name like example.com, not preceded or followed by @.
+size_t matchDomain(const std::string& s, size_t i) {
+  if ((i > 0 && s[i - 1] == '@') || !isUrlAlnum(codepoint(s, i))) {
+    return i;
+  }
+  size_t end = i;
+  size_t p = skip(s, i, isUrlAlnum);
+  while (s[p] == '.' || s[p] == '-') {
+    const size_t label = p + 1;
+    const size_t q = skip(s, label, isUrlAlnum);
+    if (q == label) {
+      break;
+    }
+    const size_t n = length(s, label, q);
+    if (s[p] == '.' && n >= 2 && n <= 13 && skip(s, label, isUrlAlpha) == q &&
+        !isWord(codepoint(s, q))) {
+      if (s[q] == '/') {
+        end = s[q + 1] == '@' ? q : q + 1;
+      } else if (s[q] != '@') {
+        end = q;
+      }
+    }
+    p = q;
+  }
+  return end;
+}
+
+// URLs as NLTK's casual tokenizer finds them (after John Gruber).
+size_t matchUrl(const std::string& s, size_t i) {
+  // http: or https:
+  const char* scheme = "https";
+  size_t q = i;
+  int32_t k = 0;
+  for (uint32_t cp; k < 5; k++) {
+    const size_t len = decode(s, q, cp);
+    if (fold(cp) != uint32_t(scheme[k])) {
+      break;
+    }
+    q += len;
+  }
+  uint32_t cp;
+  if (k >= 4 && s[q] == ':') {
+    q++;
+    size_t slashes = 0;
+    while (slashes < 3 && s[q + slashes] == '/') {
+      slashes++;
+    }
+    for (size_t k = slashes; k > 0; k--) {
+      size_t end = urlBody(s, q + k);
+      if (end > q + k) {
+        return end;
+      }
+    }
+    size_t len = decode(s, q, cp);
+    if (isUrlAlnum(cp) || cp == '%') {
+      size_t end = urlBody(s, q + len);
+      if (end > q + len) {
+        return end;
+      }
+    }
+  }
+  // a domain followed by a slash
+  const size_t r = skip(s, i, [](uint32_t c) {
+    return isUrlAlnum(c) || c == '.' || c == '-';
+  });
+  if (s[r] == '/') {
+    size_t tld = r;
+    while (tld > i && s[tld - 1] != '.') {
+      tld--;
+    }
+    const size_t n = length(s, tld, r);
+    if (tld > i + 1 && n >= 2 && n <= 13 && skip(s, tld, isUrlAlpha) == r) {
+      size_t end = urlBody(s, r + 1);
+      if (end > r + 1) {
+        return end;
+      }
+    }
+  }
+  return matchDomain(s, i);
+}
+
+bool isPhoneSeparator(uint32_t cp) {
+  return cp == ' ' || cp == '*' || cp == '-' || cp == '.' || cp == ')';
+}
+
+bool digits(const std::string& s, size_t p, size_t n) {
+  return skip(s, p, isDigit) - p >= n;
+}
+
+// Phone numbers: [+][01] [(]ddd ddd dddd, with optional separators.
+size_t matchPhone(const std::string& s, size_t i) {
+  for (int32_t international = 1; international >= 0; international--) {
+    for (int32_t area = 1; area >= 0; area--) {
+      size_t p = i;
+      if (international) {
+        if (s[p] == '+') {
+          p++;
+        }
+        if (s[p] != '0' && s[p] != '1') {
+          continue;
+        }
+        p = skip(s, p + 1, isPhoneSeparator);
+      }
+      if (area) {
+        if (s[p] == '(') {
+          p++;
+        }
+        if (!digits(s, p, 3)) {
+          continue;
+        }
+        p = skip(s, p + 3, isPhoneSeparator);
+      }
+      if (!digits(s, p, 3)) {
+        continue;
+      }
+      p = skip(s, p + 3, isPhoneSeparator);
+      if (digits(s, p, 4)) {
+        return p + 4;
+      }
+    }
+  }
+  return i;
+}
+
+bool isEye(char c) {
+  return c != 0 && strchr(":;=8", c) != nullptr;
+}
+
+bool isNose(char c) {
+  return c != 0 && strchr("-oO*'", c) != nullptr;
+}
+
+bool isMouth(char c) {
+  return c != 0 && strchr(")]([dDpP/:}{@|\\", c) != nullptr;
+}
+
+// :-) (-: <3 and the like
+size_t matchEmoticon(const std::string& s, size_t i) {
+  size_t p = s[i] == '<' || s[i] == '>' ? i + 1 : i;
+  if (isEye(s[p])) {
+    if (isNose(s[p + 1]) && isMouth(s[p + 2])) {
+      return p + 3;
+    }
+    if (isMouth(s[p + 1])) {
+      return p + 2;
+    }
+  }
+  if (isMouth(s[i])) {
+    p = i + 1;
+    if (isNose(s[p]) && isEye(s[p + 1])) {
+      p += 2;
+    } else if (isEye(s[p])) {
+      p++;
+    } else {
+      return i;
+    }
+    return s[p] == '<' || s[p] == '>' ? p + 1 : p;
+  }
+  if (s[i] == '<') {
+    p = s[i + 1] == '/' ? i + 2 : i + 1;
+    if (s[p] == '3') {
+      return p + 1;
+    }
+  }
+  return i;
+}
+
+// <tag>, -> and <--
+size_t matchTagOrArrow(const std::string& s, size_t i) {
+  if (s[i] == '<') {
+    size_t p = skip(s, i + 1, [](uint32_t cp) {
+      return cp != '>' && !isSpace(cp) && cp != END;
+    });
+    if (p > i + 1 && s[p] == '>') {
+      return p + 1;
+    }
+  }
+  if (s[i] == '-') {
+    size_t p = i + 1;
+    while (s[p] == '-') {
+      p++;
+    }
+    if (s[p] == '>') {
+      return p + 1;
+    }
+  }
+  if (s[i] == '<' && s[i + 1] == '-') {
+    size_t p = i + 2;
+    while (s[p] == '-') {
+      p++;
+    }
+    return p;
+  }
+  return i;
+}
+
+// @user and #hashtag
+size_t matchHandle(const std::string& s, size_t i) {
+  if (s[i] == '@') {
+    const size_t end = skip(s, i + 1, isWord);
+    return end > i + 1 ? end : i;
+  }
+  if (s[i] != '#') {
+    return i;
+  }
+  size_t p = i + 1;
+  while (s[p] == '#') {
+    p++;
+  }
+  uint32_t cp;
+  size_t len = decode(s, p, cp);
+  if (!isWord(cp)) {
+    return i;
+  }
+  size_t end = i;
+  for (p += len; (len = decode(s, p, cp)) > 0; p += len) {
+    if (isWord(cp)) {
+      end = p + len;
+    } else if (cp != '\'' && cp != '-') {
+      break;
+    }
+  }
+  return end;
+}
+
+size_t matchEmail(const std::string& s, size_t i) {
+  size_t p = skip(s, i, [](uint32_t cp) {
+    return isWord(cp) || cp == '.' || cp == '+' || cp == '-';
+  });
+  if (p == i || s[p] != '@') {
+    return i;
+  }
+  auto part = [](uint32_t cp) { return isWord(cp) || cp == '-'; };
+  size_t q = skip(s, p + 1, part);
+  if (q == p + 1 || s[q] != '.') {
+    return i;
+  }
+  size_t end = i;
+  int32_t n = 0;
+  uint32_t cp;
+  size_t len;
+  q++;
+  while ((len = decode(s, q, cp)) > 0 && part(cp)) {
+    q += len;
+    if (++n >= 2) {
+      end = q;
+    }
+    if (s[q] == '.') {
+      q++;
+    }
+  }
+  return end;
+}
+
+bool isSkinTone(uint32_t cp) {
+  return cp >= 0x1f3fb && cp <= 0x1f3ff;
+}
+
+// Emoji joined by zero width joiners or with a skin tone, and flags.
+size_t matchEmoji(const std::string& s, size_t i) {
+  uint32_t cp;
+  size_t p = i + decode(s, i, cp);
+  if (cp == '\n') {
+    return i;
+  }
+  size_t q = p, end = i, len = decode(s, q, cp);
+  if (isSkinTone(cp)) {
+    q += len;
+  }
+  while ((len = decode(s, q, cp)) > 0 && cp == 0x200d) {
+    size_t r = q + len;
+    len = decode(s, r, cp);
+    if (len == 0 || cp == '\n') {
+      break;
+    }
+    r += len;
+    len = decode(s, r, cp);
+    q = end = isSkinTone(cp) ? r + len : r;
+  }
+  if (end > i) {
+    return end;
+  }
+  len = decode(s, p, cp);
+  if (isSkinTone(cp)) {
+    return p + len;
+  }
+
+  decode(s, i, cp);
+  if (cp >= 0x1f1e6 && cp <= 0x1f1ff) {
+    len = decode(s, p, cp);
+    return cp >= 0x1f1e6 && cp <= 0x1f1ff ? p + len : i;
+  }
+  if (cp == 0x1f3f4) {
+    // the flags of England, Scotland and Wales
+    std::string tag;
+    for (q = p; (len = decode(s, q, cp)) > 0 && cp > 0xe0000 && cp < 0xe007f;
+         q += len) {
+      tag.push_back(char(cp - 0xe0000));
+    }
+    if (cp == 0xe007f && (tag == "gbeng" || tag == "gbsct" || tag == "gbwls")) {
+      return q + len;
+    }
+  }
+  return i;
+}
+
+// Words with apostrophes or dashes, numbers with fractions or decimals,
+// words and ellipses.
+size_t matchWord(const std::string& s, size_t i) {
+  uint32_t cp;
+  size_t len = decode(s, i, cp);
+  if (isLetter(cp)) {
+    size_t end = i;
+    int32_t n = 0;
+    for (size_t p = i + len; (len = decode(s, p, cp)) > 0; p += len) {
+      if (isLetter(cp)) {
+        if (++n >= 2) {
+          end = p + len;
+        }
+      } else if (cp == '\'' || cp == '-' || cp == '_') {
+        n++;
+      } else {
+        break;
+      }
+    }
+    if (end > i) {
+      return end;
+    }
+  }
+  size_t p = s[i] == '+' || s[i] == '-' ? i + 1 : i;
+  size_t q = skip(s, p, isDigit);
+  if (q > p && s[q] != 0 && strchr(",/.:-", s[q]) != nullptr) {
+    size_t r = skip(s, q + 1, isDigit);
+    if (r > q + 1) {
+      return s[r] == '+' || s[r] == '-' ? r + 1 : r;
+    }
+  }
+  p = skip(s, i, isWord);
+  if (p > i) {
+    return p;
+  }
+  if (s[i] == '.') {
+    size_t end = i;
+    for (p = i + 1; ; p++) {
+      p = skip(s, p, isSpace);
+      if (s[p] != '.') {
+        break;
+      }
+      end = p + 1;
+    }
+    if (end > i) {
+      return end;
+    }
+  }
+  return i;
+}
+
+// Replaces &amp; &#38; and &#x26; the way NLTK does (even &x26;), and
+// drops references it does not know. Returns the end of the reference, or
+// i if there is none at s[i].
+size_t replaceEntity(const std::string& s, size_t i, std::string& out) {
+  for (int32_t hash = 1; hash >= 0; hash--) {
+    for (int32_t hex = 1; hex >= 0; hex--) {
+      size_t p = i + 1;
+      if (hash && s[p++] != '#') {
+        continue;
+      }
+      if (hex && s[p++] != 'x') {
+        continue;
+      }
+      const size_t q = skip(s, p, [](uint32_t cp) {
+        return cp != '&' && cp != ';' && !isSpace(cp) && cp != END;
+      });
+      if (q == p || s[q] != ';') {
+        continue;
+      }
+      int64_t cp = -1;
+      if (hash || hex) {
+        // int(body, base): a sign, 0x for hex, digits with single underscores
+        const int64_t base = hex ? 16 : 10;
+        const bool negative = s[p] == '-';
+        if (s[p] == '+' || s[p] == '-') {
+          p++;
+        }
+        if (hex && q - p > 2 && s[p] == '0' && (s[p + 1] == 'x' || s[p + 1] == 'X')) {
+          p += 2;
+        }
+        int64_t value = 0;
+        bool digit = false;
+        for (; p < q; p++) {
+          const char c = s[p];
+          int64_t d = isDigit(c) ? c - '0' : (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ?
+                      (c | 0x20) - 'a' + 10 : base;
+          if (c == '_' && digit && p + 1 < q) {
+            digit = false;
+            continue;
+          }
+          if (d >= base) {
+            break;
+          }
+          value = std::min(value * base + d, int64_t(END));
+          digit = true;
+        }
+        if (p == q && digit) {
+          cp = negative ? -value : value;
+        }
+        if (cp >= 0x80 && cp <= 0x9f) {
+          cp = CP1252[cp - 0x80] ? CP1252[cp - 0x80] : -1;
+        }
+      } else {
+        const std::string name = s.substr(p, q - p);
+        const Entity* end = ENTITIES + sizeof(ENTITIES) / sizeof(Entity);
+        const Entity* e = std::lower_bound(ENTITIES, end, name,
+          [](const Entity& a, const std::string& b) { return b.compare(a.name) > 0; });
+        if (e != end && name == e->name) {
+          cp = e->cp;
+        }
+      }
+      if (cp >= 0 && cp < END && !(cp >= 0xd800 && cp < 0xe000)) {
+        encode(out, uint32_t(cp));
+      }
+      return q + 1;
+    }
+  }
+  return i;
+}
+
+// tweetTokenize.py's patterns for urls (www. http:// https:// htt://) and
+// user names: the length of the prefix that starts one at s[i], or 0.
+size_t urlPrefix(const std::string& s, size_t i) {
+  if (s[i] == 'w') {
+    return startsWith(s, i, "www.") ? 4 : 0;
+  }
+  if (s[i] != 'h') {
+    return 0;
+  }
+  return startsWith(s, i, "https://") ? 8 : startsWith(s, i, "http://") ? 7 :
+         startsWith(s, i, "htt://") ? 6 : 0;
+}
+
+size_t userPrefix(const std::string& s, size_t i) {
+  return s[i] == '@' ? 1 : 0;
+}
+
+// Replaces each match of a prefix followed by non-space characters with
+// tag, like re.sub does with tweetTokenize.py's patterns.
+void replaceMatches(const std::string& in, std::string& out,
+                    size_t (*prefix)(const std::string&, size_t),
+                    const char* tag) {
+  out.clear();
+  auto word = [](uint32_t cp) { return !isSpace(cp) && cp != END; };
+  for (size_t i = 0; i < in.size();) {
+    const size_t n = prefix(in, i);
+    if (n > 0 && word(codepoint(in, i + n))) {
+      out.append(tag);
+      i = skip(in, i + n, word);
+    } else {
+      out.push_back(in[i++]);
+    }
+  }
+}
+
+}
+
+// HTML entities are replaced and runs of four or more of a character other
+// than a letter or digit shortened to three, as TweetTokenizer does first.
+void Tokenizer::clean(const std::string& text) {
+  const std::string* s = &text;
+  if (text.find('&') != std::string::npos) {
+    decoded_.clear();
+    for (size_t i = 0; i < text.size(); i++) {
+      size_t end = text[i] == '&' ? replaceEntity(text, i, decoded_) : i;
+      if (end > i) {
+        i = end - 1;
+      } else {
+        decoded_.push_back(text[i]);
+      }
+    }
+    s = &decoded_;
+  }
+  text_.clear();
+  uint32_t cp;
+  size_t len;
+  for (size_t i = 0; (len = decode(*s, i, cp)) > 0;) {
+    size_t p = i + len;
+    int32_t n = 1;
+    while (p + len <= s->size() && s->compare(p, len, *s, i, len) == 0) {
+      p += len;
+      n++;
+    }
+    if (n > 3 && !isAsciiAlnum(cp)) {
+      for (int32_t k = 0; k < 3; k++) {
+        text_.append(*s, i, len);
+      }
+    } else {
+      text_.append(*s, i, p - i);
+    }
+    i = p;
+  }
+}
+
+// Finds the token after pos in text_, in the order of TweetTokenizer's
+// patterns: the first that matches wins.
+bool Tokenizer::next(size_t& pos, size_t& begin) const {
+  const std::string& s = text_;
+  uint32_t cp;
+  size_t len;
+  // only an emoji with a skin tone or joiner may start with a space
+  while ((len = decode(s, pos, cp)) > 0 && isSpace(cp)) {
+    size_t end = matchEmoji(s, pos);
+    if (end > pos) {
+      begin = pos;
+      pos = end;
+      return true;
+    }
+    pos += len;
+  }
+  if (len == 0) {
+    return false;
+  }
+  begin = pos;
+  size_t (*const rules[])(const std::string&, size_t) = {
+    matchUrl, matchPhone, matchEmoticon, matchTagOrArrow, matchHandle,
+    matchEmail, matchEmoji, matchWord
+  };
+  for (size_t k = 0; k < sizeof(rules) / sizeof(rules[0]); k++) {
+    size_t end = rules[k](s, pos);
+    if (end > pos) {
+      pos = end;
+      return true;
+    }
+  }
+  pos += len;
+  return true;
+}
+
+void Tokenizer::tokenize(const std::string& text,
+                         std::vector<std::string>& tokens) {
+  clean(text);
+  tokens.clear();
+  size_t pos = 0, begin;
+  while (next(pos, begin)) {
+    tokens.push_back(text_.substr(begin, pos - begin));
+  }
+}
+
+// Returns the number of tokens.
+int32_t Tokenizer::preprocess(const std::string& text, std::string& out) {
+  clean(text);
+  joined_.clear();
+  int32_t ntokens = 0;
+  size_t pos = 0, begin;
+  while (next(pos, begin)) {
+    if (ntokens++ > 0) {
+      joined_.push_back(' ');
+    }
+    uint32_t cp;
+    for (size_t p = begin; p < pos;) {
+      const unsigned char c = text_[p];
+      if (c < 0x80) {
+        joined_.push_back(c >= 'A' && c <= 'Z' ? c + 32 : c);
+        p++;
+        continue;
+      }
+      size_t len = decode(text_, p, cp);
+      if (cp == 0x130) {
+        // I with a dot above lowercases to i and a combining dot
+        joined_.append("i\xcc\x87");
+      } else if (len > 1 && lower(cp) != cp) {
+        encode(joined_, lower(cp));
+      } else {
+        joined_.append(text_, p, len);
+      }
+      p += len;
+    }
+  }
+  replaceMatches(joined_, urls_, urlPrefix, "<url>");
+  replaceMatches(urls_, out, userPrefix, "<user>");
+  return ntokens;
+}
+
+}
@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef FASTTEXT_TOKENIZER_H
+#define FASTTEXT_TOKENIZER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fasttext {
+
+// Tokenizer for raw text that reproduces the preprocessing of
+// tweetTokenize.py: NLTK's TweetTokenizer with its default options, then
+// lowercasing and replacing urls by <url> and @handles by <user>.
+//
+// Text is UTF-8. Where NLTK relies on Unicode properties, word characters
+// and whitespace are told apart by code point ranges, and only Latin, Greek,
+// Cyrillic and Armenian letters are lowercased. Instances keep scratch
+// buffers, so each thread needs its own.
+class Tokenizer {
+  private:
+    std::string decoded_;
+    std::string text_;
+    std::string joined_;
+    std::string urls_;
+
+    void clean(const std::string&);
+    bool next(size_t&, size_t&) const;
+
+  public:
+    void tokenize(const std::string&, std::vector<std::string>&);
+    int32_t preprocess(const std::string&, std::string&);
+};
+
+}
+
+#endif
@@ -24,6 +24,33 @@ namespace utils {
     ifs.clear();
     ifs.seekg(std::streampos(pos));
   }
+
+  std::string base64(const char* data, size_t size) {
+    static const char table[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const unsigned char* in = (const unsigned char*) data;
+    std::string out;
+    out.reserve(4 * ((size + 2) / 3));
+    size_t i = 0;
+    for (; i + 2 < size; i += 3) {
+      uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+      out.push_back(table[(v >> 18) & 63]);
+      out.push_back(table[(v >> 12) & 63]);
+      out.push_back(table[(v >> 6) & 63]);
+      out.push_back(table[v & 63]);
+    }
+    if (i < size) {
+      uint32_t v = in[i] << 16;
+      if (i + 1 < size) {
+        v |= in[i + 1] << 8;
+      }
+      out.push_back(table[(v >> 18) & 63]);
+      out.push_back(table[(v >> 12) & 63]);
+      out.push_back(i + 1 < size ? table[(v >> 6) & 63] : '=');
+      out.push_back('=');
+    }
+    return out;
+  }
 }
 
 }
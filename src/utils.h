@@ -10,7 +10,10 @@
 #ifndef FASTTEXT_UTILS_H
 #define FASTTEXT_UTILS_H
 
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <string>
 
 namespace fasttext {
 
@@ -18,6 +21,67 @@ namespace utils {
 
   int64_t size(std::ifstream&);
   void seek(std::ifstream&, int64_t);
+  std::string base64(const char*, size_t);
+
+  // IEEE 754 binary16, round to nearest even.
+  inline uint16_t floatToHalf(float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    const uint32_t sign = u & 0x80000000u;
+    u ^= sign;
+    uint16_t h;
+    if (u >= 0x47800000u) {
+      h = (u > 0x7f800000u) ? 0x7e00 : 0x7c00;
+    } else if (u < 0x38800000u) {
+      float g;
+      std::memcpy(&g, &u, sizeof(g));
+      g += 0.5f;
+      std::memcpy(&u, &g, sizeof(u));
+      h = uint16_t(u - 0x3f000000u);
+    } else {
+      const uint32_t odd = (u >> 13) & 1;
+      u += 0xc8000fffu + odd;
+      h = uint16_t(u >> 13);
+    }
+    return h | uint16_t(sign >> 16);
+  }
+
+  inline float halfToFloat(uint16_t h) {
+    uint32_t u = uint32_t(h & 0x7fff) << 13;
+    const uint32_t exp = u & 0x0f800000u;
+    u += 0x38000000u;
+    if (exp == 0x0f800000u) {
+      u += 0x38000000u;
+    } else if (exp == 0) {
+      u += 0x00800000u;
+      float f;
+      std::memcpy(&f, &u, sizeof(f));
+      f -= 6.10351562e-05f;
+      std::memcpy(&u, &f, sizeof(u));
+    }
+    u |= uint32_t(h & 0x8000) << 16;
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+  }
+
+  // bfloat16 is the upper half of a float32, round to nearest even.
+  inline uint16_t floatToBfloat(float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    if ((u & 0x7fffffffu) > 0x7f800000u) {
+      return uint16_t((u >> 16) | 0x40);
+    }
+    u += 0x7fff + ((u >> 16) & 1);
+    return uint16_t(u >> 16);
+  }
+
+  inline float bfloatToFloat(uint16_t h) {
+    const uint32_t u = uint32_t(h) << 16;
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+  }
 }
 
 }
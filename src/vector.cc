@@ -16,6 +16,7 @@
 
 #include "matrix.h"
 #include "qmatrix.h"
+#include "cmatrix.h"
 
 namespace fasttext {
 
@@ -89,6 +90,10 @@ void Vector::addRow(const QMatrix& A, int64_t i) {
   A.addToVector(*this, i);
 }
 
+void Vector::addRow(const CMatrix& A, int64_t i) {
+  A.addToVector(*this, i);
+}
+
 void Vector::mul(const Matrix& A, const Vector& vec) {
   assert(A.m_ == m_);
   assert(A.n_ == vec.m_);
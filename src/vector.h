@@ -19,6 +19,7 @@ namespace fasttext {
 
 class Matrix;
 class QMatrix;
+class CMatrix;
 
 class Vector {
 
@@ -40,6 +41,7 @@ class Vector {
     void addVector(const Vector&, real);
     void addRow(const Matrix&, int64_t);
     void addRow(const QMatrix&, int64_t);
+    void addRow(const CMatrix&, int64_t);
     void addRow(const Matrix&, int64_t, real);
     void mul(const QMatrix&, const Vector&);
     void mul(const Matrix&, const Vector&);